@@ -0,0 +1,75 @@
+// File: alloc_check.cpp
+#include <string>
+#include <stdexcept>
+#include "alloc_check.h"
+
+#ifdef VMC_ALLOC_CHECK
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <Eigen/Core>
+
+namespace {
+std::atomic<bool> armed_{false};
+std::atomic<long> num_allocs_{0};
+}
+
+void* operator new(std::size_t size)
+{
+  if (armed_.load(std::memory_order_relaxed)) 
+    num_allocs_.fetch_add(1, std::memory_order_relaxed);
+  if (size == 0) size = 1;
+  void* p = std::malloc(size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+namespace alloc_check {
+
+void arm(void) 
+{
+  num_allocs_.store(0);
+  armed_.store(true);
+#ifdef EIGEN_RUNTIME_NO_MALLOC
+  Eigen::internal::set_is_malloc_allowed(false);
+#endif
+}
+
+void disarm(void) 
+{
+  armed_.store(false);
+#ifdef EIGEN_RUNTIME_NO_MALLOC
+  Eigen::internal::set_is_malloc_allowed(true);
+#endif
+}
+
+long num_allocations(void) { return num_allocs_.load(); }
+
+void verify(const char* where)
+{
+  if (num_allocs_.load() > 0) {
+    throw std::logic_error(std::string(where) + ": " + 
+      std::to_string(num_allocs_.load()) + " heap allocations in the sampling loop");
+  }
+}
+
+} // end namespace alloc_check
+
+#else
+
+namespace alloc_check {
+
+void arm(void) {}
+void disarm(void) {}
+long num_allocations(void) { return 0; }
+void verify(const char* where) {}
+
+} // end namespace alloc_check
+
+#endif
@@ -0,0 +1,20 @@
+// File: alloc_check.h
+#ifndef ALLOC_CHECK_H
+#define ALLOC_CHECK_H
+
+/*---------------------------------------------------------------------------
+* Debugging aid to make sure the sampling loop does not touch the heap.
+* Compile with '-DVMC_ALLOC_CHECK -DEIGEN_RUNTIME_NO_MALLOC'. Between 'arm' 
+* and 'disarm' every 'operator new' is counted and Eigen asserts on any 
+* allocation of its own. Without VMC_ALLOC_CHECK all of these are no-ops.
+*----------------------------------------------------------------------------*/
+namespace alloc_check {
+
+void arm(void);
+void disarm(void);
+long num_allocations(void);
+void verify(const char* where);
+
+} // end namespace alloc_check
+
+#endif
@@ -0,0 +1,310 @@
+// File: amplitude_table.cpp
+#include <stdexcept>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <chrono>
+#include <new>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <signal.h>
+#include <dirent.h>
+#include <vector>
+#include <cstdio>
+#include "amplitude_table.h"
+
+bool AmplitudeTable::create(const table_mode& mode, const int& rows, const int& cols, 
+  const std::string& name, const std::uint64_t& key)
+{
+  release();
+  mode_ = mode;
+  rows_ = rows;
+  cols_ = cols;
+  name_ = name;
+  key_ = key;
+  if (mode_ == table_mode::PRIVATE) {
+    private_data_.resize(rows_,cols_);
+    data_ = private_data_.data();
+    owner_ = true;
+    return true;
+  }
+  if (name_.empty()) 
+    throw std::invalid_argument("AmplitudeTable::create: shared table needs a name");
+  if (mode_ == table_mode::DISK_CACHE) return create_cached();
+  return create_shared();
+}
+
+bool AmplitudeTable::create_shared(void)
+{
+  // once more if the one found was left behind by a creator that died
+  for (int attempt=0; attempt<2; ++attempt) {
+    if (open_shared()) return owner_;
+  }
+  throw std::runtime_error("AmplitudeTable::create: '"+name_+"' is left unfilled");
+}
+
+bool AmplitudeTable::open_shared(void)
+{
+  // SHARED_MEMORY names are like "/name", MAPPED_FILE names are paths
+  std::size_t total_size = header_size_ + size_in_bytes();
+  bool shm = (mode_ == table_mode::SHARED_MEMORY);
+  int fd = shm ? shm_open(name_.c_str(), O_CREAT|O_EXCL|O_RDWR, 0600) 
+    : open(name_.c_str(), O_CREAT|O_EXCL|O_RDWR, 0600);
+  owner_ = (fd >= 0);
+  if (!owner_) {
+    if (errno != EEXIST) 
+      throw std::runtime_error("AmplitudeTable::create: opening '"+name_+"' failed");
+    fd = shm ? shm_open(name_.c_str(), O_RDWR, 0600) : open(name_.c_str(), O_RDWR);
+    if (fd < 0) throw std::runtime_error("AmplitudeTable::create: opening '"+name_+"' failed");
+  }
+  // held as long as the table is mapped (see 'release')
+  flock(fd, LOCK_SH);
+  if (owner_) {
+    // the header first, the table gets its full size once the header is set
+    if (ftruncate(fd, header_size_) != 0) {
+      unlink_name(fd);
+      close(fd);
+      throw std::runtime_error("AmplitudeTable::create: resizing '"+name_+"' failed");
+    }
+  }
+  else {
+    // the creator may not have sized it yet (not after 10 s: it died)
+    struct stat st;
+    for (int n=0; ; ++n) {
+      if (fstat(fd, &st) != 0) st.st_size = 0;
+      if (static_cast<std::size_t>(st.st_size) >= total_size) break;
+      if (n > 10000) {
+        if (st.st_size==0 || static_cast<std::size_t>(st.st_size)==header_size_) {
+          unlink_name(fd);
+          close(fd);
+          return false;
+        }
+        close(fd);
+        throw std::runtime_error("AmplitudeTable::create: '"+name_+"' has wrong size");
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  // header read-write, table read-only except for the creator
+  void* p = mmap(nullptr, total_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) {
+    if (owner_) unlink_name(fd);
+    close(fd);
+    throw std::runtime_error("AmplitudeTable::create: mmap failed");
+  }
+  fd_ = fd;
+  mapped_size_ = total_size;
+  header_ = static_cast<header_t*>(p);
+  data_ = reinterpret_cast<amplitude_t*>(static_cast<char*>(p)+header_size_);
+  if (owner_) {
+    header_->magic = magic_;
+    header_->rows = rows_;
+    header_->cols = cols_;
+    new (&header_->ready) std::atomic<int>(0);
+    header_->key = key_;
+    header_->creator = getpid();
+    if (ftruncate(fd, total_size) != 0) {
+      release();
+      throw std::runtime_error("AmplitudeTable::create: resizing '"+name_+"' failed");
+    }
+  }
+  else {
+    bool ready;
+    try { ready = wait_ready(); }
+    catch (...) { release(); throw; }
+    if (!ready) {
+      // the creator died: remove it, unless already replaced by a new one
+      munmap(header_, mapped_size_);
+      header_ = nullptr;
+      data_ = nullptr;
+      mapped_size_ = 0;
+      unlink_name(fd_);
+      close(fd_);
+      fd_ = -1;
+      return false;
+    }
+    if (header_->magic!=magic_ || header_->rows!=rows_ || header_->cols!=cols_ 
+      || header_->key!=key_) {
+      release();
+      throw std::runtime_error("AmplitudeTable::create: '"+name_+"' does not match");
+    }
+    mprotect(data_, size_in_bytes(), PROT_READ);
+  }
+  return true;
+}
+
+void AmplitudeTable::unlink_name(const int& fd) const
+{
+  // only if the name still refers to the file open as 'fd'
+  bool shm = (mode_ == table_mode::SHARED_MEMORY);
+  struct stat st, st_now;
+  if (fstat(fd, &st) != 0) return;
+  int fd_now = shm ? shm_open(name_.c_str(), O_RDONLY, 0600) : open(name_.c_str(), O_RDONLY);
+  if (fd_now < 0) return;
+  bool same = (fstat(fd_now, &st_now)==0 && st_now.st_dev==st.st_dev && st_now.st_ino==st.st_ino);
+  close(fd_now);
+  if (!same) return;
+  if (shm) shm_unlink(name_.c_str());
+  else unlink(name_.c_str());
+}
+
+int AmplitudeTable::remove_unused(const table_mode& mode, const std::string& dir, 
+  const std::string& prefix)
+{
+  if (mode!=table_mode::SHARED_MEMORY && mode!=table_mode::MAPPED_FILE) return 0;
+  bool shm = (mode == table_mode::SHARED_MEMORY);
+  // (Linux keeps the shared memory objects in /dev/shm)
+  DIR* d = opendir(shm ? "/dev/shm" : dir.c_str());
+  if (d == nullptr) return 0;
+  std::vector<std::string> names;
+  while (struct dirent* e = readdir(d)) {
+    std::string name(e->d_name);
+    if (name.compare(0, prefix.size(), prefix) == 0) names.push_back(name);
+  }
+  closedir(d);
+  int num_removed = 0;
+  for (const auto& entry : names) {
+    std::string name = shm ? "/"+entry : dir+"/"+entry;
+    int fd = shm ? shm_open(name.c_str(), O_RDONLY, 0600) : open(name.c_str(), O_RDONLY);
+    if (fd < 0) continue;
+    // nobody holds its lock: no walker has it mapped
+    if (flock(fd, LOCK_EX|LOCK_NB) == 0) {
+      if ((shm ? shm_unlink(name.c_str()) : unlink(name.c_str())) == 0) ++num_removed;
+    }
+    close(fd);
+  }
+  return num_removed;
+}
+
+bool AmplitudeTable::create_cached(void)
+{
+  // warm start
+  int fd = open(name_.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    bool found = map_cached(fd);
+    close(fd);
+    if (found) return false;
+  }
+  // cold start: build under a private name, 'publish' renames it
+  std::size_t total_size = header_size_ + size_in_bytes();
+  std::ostringstream os;
+  os << name_ << ".tmp." << getpid() << "." << this;
+  tmp_name_ = os.str();
+  fd = open(tmp_name_.c_str(), O_CREAT|O_EXCL|O_RDWR, 0644);
+  if (fd < 0) throw std::runtime_error("AmplitudeTable::create: opening '"+tmp_name_+"' failed");
+  if (ftruncate(fd, total_size) != 0) {
+    close(fd);
+    unlink(tmp_name_.c_str());
+    throw std::runtime_error("AmplitudeTable::create: resizing '"+tmp_name_+"' failed");
+  }
+  void* p = mmap(nullptr, total_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    unlink(tmp_name_.c_str());
+    throw std::runtime_error("AmplitudeTable::create: mmap failed");
+  }
+  mapped_size_ = total_size;
+  header_ = static_cast<header_t*>(p);
+  data_ = reinterpret_cast<amplitude_t*>(static_cast<char*>(p)+header_size_);
+  header_->magic = magic_;
+  header_->rows = rows_;
+  header_->cols = cols_;
+  new (&header_->ready) std::atomic<int>(0);
+  header_->key = key_;
+  owner_ = true;
+  return true;
+}
+
+bool AmplitudeTable::map_cached(const int& fd)
+{
+  std::size_t total_size = header_size_ + size_in_bytes();
+  struct stat st;
+  if (fstat(fd, &st)!=0 || static_cast<std::size_t>(st.st_size)!=total_size) return false;
+  void* p = mmap(nullptr, total_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) return false;
+  header_t* header = static_cast<header_t*>(p);
+  if (header->magic!=magic_ || header->rows!=rows_ || header->cols!=cols_ 
+    || header->key!=key_ || header->ready.load()!=1) {
+    munmap(p, total_size);
+    return false;
+  }
+  mapped_size_ = total_size;
+  header_ = header;
+  data_ = reinterpret_cast<amplitude_t*>(static_cast<char*>(p)+header_size_);
+  owner_ = false;
+  return true;
+}
+
+AmplitudeTable::amplitude_t* AmplitudeTable::mutable_data(void)
+{
+  if (!owner_) throw std::logic_error("AmplitudeTable::mutable_data: table is read-only");
+  return data_;
+}
+
+void AmplitudeTable::publish(void)
+{
+  if (header_ == nullptr) return;
+  if (owner_) {
+    mprotect(data_, size_in_bytes(), PROT_READ);
+    header_->ready.store(1, std::memory_order_release);
+    if (mode_ == table_mode::DISK_CACHE) {
+      msync(header_, mapped_size_, MS_SYNC);
+      if (rename(tmp_name_.c_str(), name_.c_str()) != 0) unlink(tmp_name_.c_str());
+      tmp_name_.clear();
+    }
+  }
+}
+
+bool AmplitudeTable::wait_ready(void) const
+{
+  // wait for the creator to fill the table (10 minutes at most), false if
+  // it died first
+  int ready;
+  for (int n=0; (ready=header_->ready.load(std::memory_order_acquire))==0; ++n) {
+    if (n > 600000) throw std::runtime_error("AmplitudeTable: timeout waiting for '"+name_+"'");
+    if (n%100==99 && kill(header_->creator, 0)!=0 && errno==ESRCH) {
+      return header_->ready.load(std::memory_order_acquire) == 1;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  if (ready < 0) throw std::runtime_error("AmplitudeTable: building '"+name_+"' failed");
+  return true;
+}
+
+void AmplitudeTable::release(void)
+{
+  if (header_ != nullptr && mode_ == table_mode::DISK_CACHE) {
+    // cache files stay, unless never completed
+    munmap(header_, mapped_size_);
+    if (!tmp_name_.empty()) unlink(tmp_name_.c_str());
+    tmp_name_.clear();
+    header_ = nullptr;
+    mapped_size_ = 0;
+  }
+  if (header_ != nullptr) {
+    // never published: tell the waiting walkers
+    if (owner_ && header_->ready.load()==0) header_->ready.store(-1, std::memory_order_release);
+    munmap(header_, mapped_size_);
+    // no other lock holder: this was the last user (with a killed run's
+    // table, the next one to map & release it)
+    if (flock(fd_, LOCK_EX|LOCK_NB) == 0) unlink_name(fd_);
+    close(fd_);
+    fd_ = -1;
+    header_ = nullptr;
+    mapped_size_ = 0;
+  }
+  private_data_.resize(0,0);
+  data_ = nullptr;
+  owner_ = false;
+}
+
+std::string KeyHash::str(void) const
+{
+  std::ostringstream os;
+  os << std::hex << std::setw(16) << std::setfill('0') << value_;
+  return os.str();
+}
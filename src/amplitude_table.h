@@ -0,0 +1,111 @@
+// File: amplitude_table.h
+#ifndef AMPLITUDE_TABLE_H
+#define AMPLITUDE_TABLE_H
+
+#include <complex>
+#include <string>
+#include <cstdint>
+#include <atomic>
+#include "./matrix.h"
+
+/*---------------------------------------------------------------------------
+* Storage of the N x N pair amplitude table of a wavefunction.
+*   PRIVATE:       on the heap of this walker
+*   SHARED_MEMORY: in a POSIX shared memory segment 
+*   MAPPED_FILE:   in a memory mapped file (for small /dev/shm)
+*   DISK_CACHE:    in a persistent file, reused by later runs
+* In the shared modes the first walker (of any process on the node) to ask 
+* for a table creates and fills it, all others map the same pages read-only.
+* Every user holds a shared flock on the segment while it has it mapped; the
+* one that releases it with no other lock holder left removes it. Locks go 
+* with a killed process, so a table left behind by a killed run is removed
+* by the next run that maps and releases it; 'remove_unused' removes all 
+* such tables. A segment whose creator died before filling it (its pid is 
+* in the header) is removed and built again; if the creator fails (throws) 
+* the waiting walkers fail as well.
+* A DISK_CACHE file is written under a temporary name and renamed when 
+* complete, so a run either maps a finished table or builds it itself. 
+* Layout: one page of header followed by the column-major table.
+*----------------------------------------------------------------------------*/
+enum class table_mode {PRIVATE, SHARED_MEMORY, MAPPED_FILE, DISK_CACHE};
+
+class AmplitudeTable
+{
+public:
+  using amplitude_t = std::complex<double>;
+  AmplitudeTable() {}
+  AmplitudeTable(const AmplitudeTable&) = delete;
+  AmplitudeTable& operator=(const AmplitudeTable&) = delete;
+  ~AmplitudeTable() { release(); }
+  bool create(const table_mode& mode, const int& rows, const int& cols, 
+    const std::string& name="", const std::uint64_t& key=0);
+  void publish(void);
+  void release(void);
+  // removes the tables named 'prefix*' (in 'dir' for MAPPED_FILE) no walker
+  // has mapped, returns their number
+  static int remove_unused(const table_mode& mode, const std::string& dir, 
+    const std::string& prefix);
+  const table_mode& mode(void) const { return mode_; }
+  const std::string& name(void) const { return name_; }
+  const int& rows(void) const { return rows_; }
+  const int& cols(void) const { return cols_; }
+  const amplitude_t* data(void) const { return data_; }
+  amplitude_t* mutable_data(void);
+  std::size_t size_in_bytes(void) const { return sizeof(amplitude_t)*rows_*cols_; }
+private:
+  struct header_t 
+  {
+    std::uint64_t magic;
+    std::int32_t rows;
+    std::int32_t cols;
+    std::atomic<int> ready; // 1: filled, -1: creator failed
+    std::uint64_t key;
+    std::int32_t creator; // pid
+  };
+  static const std::uint64_t magic_ = 0x32544c4241504d41; // "AMPLBAT2"
+  static const std::size_t header_size_ = 4096;
+  table_mode mode_{table_mode::PRIVATE};
+  std::string name_{""};
+  std::string tmp_name_{""};
+  std::uint64_t key_{0};
+  int rows_{0};
+  int cols_{0};
+  bool owner_{false};
+  int fd_{-1}; // shared modes: holds the lock
+  ComplexMatrix private_data_;
+  header_t* header_{nullptr};
+  amplitude_t* data_{nullptr};
+  std::size_t mapped_size_{0};
+
+  bool create_shared(void);
+  bool open_shared(void);
+  void unlink_name(const int& fd) const;
+  bool create_cached(void);
+  bool map_cached(const int& fd);
+  bool wait_ready(void) const;
+};
+
+/*---------------------------------------------------------------------------
+* FNV-1a hash, used to name tables after the parameters they are built from
+*----------------------------------------------------------------------------*/
+class KeyHash
+{
+public:
+  KeyHash() {}
+  void add(const void* bytes, const std::size_t& n)
+  {
+    const unsigned char* p = static_cast<const unsigned char*>(bytes);
+    for (std::size_t i=0; i<n; ++i) {
+      value_ ^= p[i];
+      value_ *= 0x100000001b3ULL;
+    }
+  }
+  template<typename T> void add(const T& x) { add(&x, sizeof(T)); }
+  const std::uint64_t& value(void) const { return value_; }
+  std::string str(void) const;
+private:
+  std::uint64_t value_{0xcbf29ce484222325ULL};
+};
+
+
+#endif
@@ -22,11 +22,11 @@ void FockBasis::init(const int& num_sites, const bool& allow_dbl)
   dn_states_.clear();
   uphole_states_.clear();
   dnhole_states_.clear();
+  all_up_states_.resize(num_sites_);
+  all_dn_states_.resize(num_sites_);
   proposed_move_ = move_t::null;
   // rng site generator
   if (num_sites_>0) rng_.set_site_generator(0,num_sites_-1);
-  // rng site generator
-  if (num_sites_>0) rng_.set_site_generator(0,num_sites_-1);
 }
 
 void FockBasis::init_spins(const int& num_upspins, const int& num_dnspins)
@@ -62,34 +62,33 @@ void FockBasis::set_random(void)
 {
   proposed_move_ = move_t::null;
   state_.setZero();
-  std::vector<int> all_up_states(num_sites_);
-  for (int i=0; i<num_sites_; ++i) all_up_states[i] = i;
-  std::shuffle(all_up_states.begin(),all_up_states.end(),rng_);
+  for (int i=0; i<num_sites_; ++i) all_up_states_[i] = i;
+  std::shuffle(all_up_states_.begin(),all_up_states_.end(),rng_);
   for (int i=0; i<num_upspins_; ++i) {
-    int state = all_up_states[i];
+    int state = all_up_states_[i];
     state_[state] = 1;
     spin_id_[state] = i;
     up_states_[i] = state;
   }
   int j=0;
   for (int i=num_upspins_; i<num_sites_; ++i) {
-    uphole_states_[j++] = all_up_states[i];
+    uphole_states_[j++] = all_up_states_[i];
   }
 
   // DN spins & holes
   if (double_occupancy_) {
-    std::vector<int> all_dn_states(num_sites_);
-    for (int i=0; i<num_sites_; ++i) all_dn_states[i] = num_sites_+i;
-    std::shuffle(all_dn_states.begin(),all_dn_states.end(),rng_);
+    for (int i=0; i<num_sites_; ++i) all_dn_states_[i] = num_sites_+i;
+    std::shuffle(all_dn_states_.begin(),all_dn_states_.end(),rng_);
     for (int i=0; i<num_dnspins_; ++i) {
-      int state = all_dn_states[i];
+      int state = all_dn_states_[i];
       state_[state] = 1;
       spin_id_[state] = i;
       dn_states_[i] = state;
+      dnspin_sites_[i] = state-num_sites_;
     }
     int j = 0;
     for (int i=num_dnspins_; i<num_sites_; ++i) {
-      dnhole_states_[j++] = all_dn_states[i];
+      dnhole_states_[j++] = all_dn_states_[i];
     }
   }
   else {
@@ -97,19 +96,20 @@ void FockBasis::set_random(void)
     // DN spins
     int j = 0;
     for (int i=num_upspins_; i<total_spins; ++i) {
-      int state = num_sites_+all_up_states[i];
+      int state = num_sites_+all_up_states_[i];
       state_[state] = 1;
       spin_id_[state] = j;
+      dnspin_sites_[j] = state-num_sites_;
       dn_states_[j++] = state;
     }
     // DN holes
     j = 0;
     for (int i=0; i<num_upspins_; ++i) {
-      int state = num_sites_+all_up_states[i];
+      int state = num_sites_+all_up_states_[i];
       dnhole_states_[j++] = state;
     }
     for (int i=total_spins; i<num_sites_; ++i) {
-      int state = num_sites_+all_up_states[i];
+      int state = num_sites_+all_up_states_[i];
       dnhole_states_[j++] = state;
     }
   }
@@ -127,34 +127,33 @@ void FockBasis::set_custom(void)
 {
   proposed_move_ = move_t::null;
   state_.setZero();
-  std::vector<int> all_up_states(num_sites_);
-  for (int i=0; i<num_sites_; ++i) all_up_states[i] = i;
-  //std::shuffle(all_up_states.begin(),all_up_states.end(),rng_);
+  for (int i=0; i<num_sites_; ++i) all_up_states_[i] = i;
+  //std::shuffle(all_up_states_.begin(),all_up_states_.end(),rng_);
   for (int i=0; i<num_upspins_; ++i) {
-    int state = all_up_states[i];
+    int state = all_up_states_[i];
     state_[state] = 1;
     spin_id_[state] = i;
     up_states_[i] = state;
   }
   int j=0;
   for (int i=num_upspins_; i<num_sites_; ++i) {
-    uphole_states_[j++] = all_up_states[i];
+    uphole_states_[j++] = all_up_states_[i];
   }
 
   // DN spins & holes
-  std::vector<int> all_dn_states(num_sites_);
-  for (int i=0; i<num_sites_; ++i) all_dn_states[i] = num_sites_+i;
-  //std::shuffle(all_dn_states.begin(),all_dn_states.end(),rng_);
+  for (int i=0; i<num_sites_; ++i) all_dn_states_[i] = num_sites_+i;
+  //std::shuffle(all_dn_states_.begin(),all_dn_states_.end(),rng_);
   int last_site = num_sites_-1;
   for (int i=0; i<num_dnspins_; ++i) {
-    int state = all_dn_states[last_site-i];
+    int state = all_dn_states_[last_site-i];
     state_[state] = 1;
     spin_id_[state] = i;
     dn_states_[i] = state;
+    dnspin_sites_[i] = state-num_sites_;
   }
   j = 0;
   for (int i=num_dnspins_; i<num_sites_; ++i) {
-    dnhole_states_[j++] = all_dn_states[last_site-i];
+    dnhole_states_[j++] = all_dn_states_[last_site-i];
   }
 
   // number of doublely occupied sites
@@ -167,6 +166,44 @@ void FockBasis::set_custom(void)
   }
 }
 
+void FockBasis::set_state(const ivector& state)
+{
+  // given occupancies of all the (UP followed by DN) states
+  if (state.size() != num_states_) 
+    throw std::range_error("* FockBasis::set_state: state size mismatch");
+  if (state.head(num_sites_).sum()!=num_upspins_ || state.tail(num_sites_).sum()!=num_dnspins_)
+    throw std::range_error("* FockBasis::set_state: spin numbers mismatch");
+  proposed_move_ = move_t::null;
+  state_ = state;
+  spin_id_.setConstant(null_id_);
+  int n = 0;
+  int m = 0;
+  for (int i=0; i<num_sites_; ++i) {
+    if (state_[i]==1) {
+      spin_id_[i] = n;
+      up_states_[n++] = i;
+    }
+    else uphole_states_[m++] = i;
+  }
+  n = 0;
+  m = 0;
+  for (int i=num_sites_; i<num_states_; ++i) {
+    if (state_[i]==1) {
+      spin_id_[i] = n;
+      dnspin_sites_[n] = i-num_sites_;
+      dn_states_[n++] = i;
+    }
+    else dnhole_states_[m++] = i;
+  }
+  // number of doublely occupied sites
+  num_dblocc_sites_ = 0;
+  for (int i=0; i<num_sites_; ++i) {
+    if (state_[i]==1 && state_[i+num_sites_]==1) num_dblocc_sites_++;
+  }
+  if (!double_occupancy_ && num_dblocc_sites_>0)
+    throw std::range_error("* FockBasis::set_state: double occupancy not allowed");
+}
+
 bool FockBasis::gen_upspin_hop(void)
 {
   if (proposed_move_!=move_t::null) undo_last_move();
@@ -424,6 +461,95 @@ int FockBasis::op_exchange_ud(const int& site_i, const int& site_j) const
   return op_sign_;
 }
 
+bool FockBasis::op_cdagc_up(const int& site_i, const int& site_j, op_move& mv) const
+{
+  // same as above, but the state is left untouched
+  mv.type = move_t::null;
+  int fr_state, to_state;
+  if (state_[site_i]==0 && state_[site_j]==1) {
+    fr_state = site_j;
+    to_state = site_i;
+  }
+  else if (state_[site_i]==1 && state_[site_j]==0) {
+    fr_state = site_i;
+    to_state = site_j;
+  }
+  else return false;
+  mv.type = move_t::upspin_hop;
+  mv.fr_site = fr_state;
+  mv.to_site = to_state;
+  mv.spin = spin_id_[fr_state];
+  mv.dn_spin = -1;
+  mv.delta_nd = state_[num_sites_+to_state]-state_[num_sites_+fr_state];
+  mv.sign = (num_occupied(fr_state,to_state)%2==0) ? 1 : -1;
+  return true;
+}
+
+bool FockBasis::op_cdagc_dn(const int& site_i, const int& site_j, op_move& mv) const
+{
+  mv.type = move_t::null;
+  int idx_i = num_sites_+site_i;
+  int idx_j = num_sites_+site_j;
+  int fr_state, to_state;
+  if (state_[idx_i]==0 && state_[idx_j]==1) {
+    fr_state = idx_j; 
+    to_state = idx_i; 
+  }
+  else if (state_[idx_i]==1 && state_[idx_j]==0) {
+    fr_state = idx_i;
+    to_state = idx_j;
+  }
+  else return false;
+  mv.type = move_t::dnspin_hop;
+  mv.fr_site = fr_state-num_sites_;
+  mv.to_site = to_state-num_sites_;
+  mv.spin = spin_id_[fr_state];
+  mv.dn_spin = mv.spin;
+  mv.delta_nd = state_[mv.to_site]-state_[mv.fr_site];
+  mv.sign = (num_occupied(fr_state,to_state)%2==0) ? 1 : -1;
+  return true;
+}
+
+bool FockBasis::op_exchange_ud(const int& site_i, const int& site_j, op_move& mv) const
+{
+  // 'true' with a 'null' move for site_i==site_j (identity)
+  mv.type = move_t::null;
+  mv.sign = 1;
+  mv.delta_nd = 0;
+  if (site_i == site_j) return true;
+  int ni_up = state_[site_i];
+  int nj_up = state_[site_j];
+  int ni_dn = state_[num_sites_+site_i];
+  int nj_dn = state_[num_sites_+site_j];
+  if (ni_up==1 && nj_up==0 && ni_dn==0 && nj_dn==1) {
+    mv.fr_site = site_i;
+    mv.to_site = site_j;
+  }
+  else if (ni_up==0 && nj_up==1 && ni_dn==1 && nj_dn==0) {
+    mv.fr_site = site_j;
+    mv.to_site = site_i;
+  }
+  else return false;
+  mv.type = move_t::exchange;
+  mv.spin = spin_id_[mv.fr_site];
+  mv.dn_spin = spin_id_[num_sites_+mv.to_site];
+  // sign convention same as in 'op_exchange_ud' above, where the loops
+  // include one end point which is occupied after the exchange 
+  int n = 1 + num_occupied(mv.fr_site,mv.to_site) + 
+    num_occupied(num_sites_+mv.to_site,num_sites_+mv.fr_site);
+  mv.sign = (n%2==0) ? 1 : -1;
+  return true;
+}
+
+int FockBasis::num_occupied(const int& fr_state, const int& to_state) const
+{
+  // number of occupied states strictly in between
+  int n = 0;
+  for (int i=fr_state+1; i<to_state; ++i) n += state_[i];
+  for (int i=to_state+1; i<fr_state; ++i) n += state_[i];
+  return n;
+}
+
 void FockBasis::commit_last_move(void)
 {
   // double occupancy count
@@ -445,6 +571,7 @@ void FockBasis::commit_last_move(void)
       spin_id_[dn_fr_state_] = null_id_;
       spin_id_[dn_to_state_] = mv_dnspin_;
       dn_states_[mv_dnspin_] = dn_to_state_;
+      dnspin_sites_[mv_dnspin_] = dn_to_state_-num_sites_;
       dnhole_states_[mv_dnhole_] = dn_fr_state_;
       proposed_move_ = move_t::null;
       break;
@@ -456,6 +583,7 @@ void FockBasis::commit_last_move(void)
       up_states_[mv_upspin_] = up_to_state_;
       uphole_states_[mv_uphole_] = up_fr_state_;
       dn_states_[mv_dnspin_] = dn_to_state_;
+      dnspin_sites_[mv_dnspin_] = dn_to_state_-num_sites_;
       dnhole_states_[mv_dnhole_] = dn_fr_state_;
       proposed_move_ = move_t::null;
       break;
@@ -16,6 +16,21 @@
 
 enum class move_t {upspin_hop, dnspin_hop, exchange, null};
 
+/* Result of applying an operator on a basis state, without changing it.
+*  For an exchange, the UP spin hops 'fr_site' -> 'to_site' and the DN spin 
+*  hops 'to_site' -> 'fr_site'.
+*/
+struct op_move
+{
+  move_t type{move_t::null};
+  int fr_site{-1};
+  int to_site{-1};
+  int spin{-1};     // which UP (or DN) spin hops
+  int dn_spin{-1};  // which DN spin hops (exchange only)
+  int sign{1};
+  int delta_nd{0};  // change in no of doubly occupied sites
+};
+
 class FockBasis 
 {
 public:
@@ -28,13 +43,10 @@ public:
   void init_spins(const int& num_upspins, const int& num_dnspins);
   const ivector& state(void) const { return state_; }
   const std::vector<int>& upspin_sites(void) const { return up_states_; }
-  const std::vector<int>& dnspin_sites(void) const 
-  { 
-    for (int i=0; i<num_dnspins_; ++i) dnspin_sites_[i] = dn_states_[i]-num_sites_;
-    return dnspin_sites_; 
-  }
+  const std::vector<int>& dnspin_sites(void) const { return dnspin_sites_; }
   void set_random(void);
   void set_custom(void);
+  void set_state(const ivector& state);
   bool gen_upspin_hop(void);
   bool gen_dnspin_hop(void);
   bool gen_exchange_move(void);
@@ -49,6 +61,10 @@ public:
   bool op_cdagc_up(const int& fr_site, const int& to_site) const;
   bool op_cdagc_dn(const int& fr_site, const int& to_site) const;
   int op_exchange_ud(const int& fr_site, const int& to_site) const;
+  // side-effect free versions of the above
+  bool op_cdagc_up(const int& site_i, const int& site_j, op_move& mv) const;
+  bool op_cdagc_dn(const int& site_i, const int& site_j, op_move& mv) const;
+  bool op_exchange_ud(const int& site_i, const int& site_j, op_move& mv) const;
   const int op_sign(void) const { return op_sign_; }
   const int delta_nd(void) const { return dblocc_increament_; }
   friend std::ostream& operator<<(std::ostream& os, const FockBasis& bs);
@@ -68,7 +84,10 @@ private:
   std::vector<int> dn_states_;
   std::vector<int> uphole_states_;
   std::vector<int> dnhole_states_;
-  mutable std::vector<int> dnspin_sites_;
+  std::vector<int> dnspin_sites_;
+  // work arrays
+  std::vector<int> all_up_states_;
+  std::vector<int> all_dn_states_;
 
   // update moves
   mutable move_t proposed_move_;
@@ -87,6 +106,7 @@ private:
   mutable int op_sign_;
   int null_id_{-1};
   void clear(void); 
+  int num_occupied(const int& fr_state, const int& to_state) const;
 };
  
 
@@ -0,0 +1,250 @@
+/* Microbenchmarks of the sampling kernels ('make bench'):
+*    bench.out [input_file] [name=value ...]
+*  sizes    = 4,8,16,32,64   linear sizes L of the LxL SQUARE lattice
+*  min_time = 0.2            seconds per measurement (at least one call)
+*  json     = bench.json     machine readable results ('' for none)
+*  Each kernel is timed in isolation on a random configuration at half
+*  filling. Bytes & flops are the ones the kernel has to touch/do (complex
+*  multiply-add = 8 flops), so GB/s and GFlop/s are effective rates. */
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <vector>
+#include "sysconfig.h"
+#include "input.h"
+
+// results go here, so that the timed loops are not optimized away
+static volatile double sink;
+
+struct bench_result
+{
+  std::string kernel;
+  std::string type;
+  int L;
+  long iterations;
+  double ns_per_op;
+  double bytes_per_op;
+  double flops_per_op;
+};
+
+// access to the SysConfig internals
+class KernelBench
+{
+public:
+  KernelBench(const double& min_time) : min_time_{min_time} {}
+  void run(const int& L, std::vector<bench_result>& results);
+private:
+  double min_time_;
+  // ns per call of 'op' (batches doubled until 'min_time_' is reached)
+  template<typename Op> double time_op(Op op, long& iterations) const;
+  void setup(SysConfig& config, const int& L) const;
+};
+
+template<typename Op> double KernelBench::time_op(Op op, long& iterations) const
+{
+  using clock = std::chrono::steady_clock;
+  op(); // warm the caches
+  long batch = 1;
+  while (true) {
+    clock::time_point t0 = clock::now();
+    for (long i=0; i<batch; ++i) op();
+    double t = std::chrono::duration<double>(clock::now()-t0).count();
+    if (t >= min_time_ || batch >= (1L<<40)) {
+      iterations = batch;
+      return 1.0E+9*t/batch;
+    }
+    batch *= 2;
+  }
+}
+
+void KernelBench::setup(SysConfig& config, const int& L) const
+{
+  // random state with a regular amplitude matrix (no SVD conditioning
+  // check as in 'init_state', too slow for the large lattices)
+  config.init(lattice_id::SQUARE, lattice_size(L,L), wf_id::BCS);
+  config.wf_.set_memo(0);
+  config.build(RealVector::Ones(config.num_vparams()));
+  config.seed(1);
+  while (true) {
+    config.basis_state_.set_random();
+    config.wf_.get_amplitudes(config.psi_mat_, config.basis_state_.upspin_sites(),
+      config.basis_state_.dnspin_sites());
+    if (config.gauss_jordan_inverse(config.psi_mat_, config.psi_inv_, config.inv_col_,
+      config.inv_row_, config.inv_pivot_)) break;
+  }
+}
+
+void KernelBench::run(const int& L, std::vector<bench_result>& results)
+{
+  SysConfig config;
+  setup(config, L);
+  const int n = config.num_upspins_;
+  const double nd = n;
+  long iters;
+  double ns;
+  auto add = [&](const std::string& kernel, const std::string& type,
+    const double& bytes, const double& flops)
+    { results.push_back(bench_result{kernel, type, L, iters, ns, bytes, flops}); };
+
+  //------- determinant ratio: dot product of length n
+  {
+    int k = 0;
+    amplitude_t sum = 0.0;
+    config.wf_.get_amplitudes(config.psi_row_, 0, config.basis_state_.dnspin_sites());
+    ns = time_op([&]() {
+      sum += config.psi_row_.cwiseProduct(config.psi_inv_.col(k)).sum();
+      if (++k == n) k = 0; }, iters);
+    add("det_ratio", "complex", 2*16*nd, 8*nd);
+    // the same for real amplitudes
+    RealVector row = config.psi_row_.real();
+    RealMatrix inv = config.psi_inv_.real();
+    double rsum = 0.0;
+    k = 0;
+    ns = time_op([&]() {
+      rsum += row.cwiseProduct(inv.col(k)).sum();
+      if (++k == n) k = 0; }, iters);
+    add("det_ratio", "real", 2*8*nd, 2*nd);
+    sink = std::abs(sum)+rsum;
+  }
+
+  //------- inverse updates: an UP (DN) spin hops to an empty site & back,
+  // so that the matrices stay well defined (2 updates per call)
+  {
+    const std::vector<int>& up_sites = config.basis_state_.upspin_sites();
+    const std::vector<int>& dn_sites = config.basis_state_.dnspin_sites();
+    std::vector<int> up_occupied(config.num_sites_, 0), dn_occupied(config.num_sites_, 0);
+    for (int s : up_sites) up_occupied[s] = 1;
+    for (int s : dn_sites) dn_occupied[s] = 1;
+    ColVector row_fr(n), row_to(n);
+    RowVector col_fr(n), col_to(n);
+    // UP spin 0 from its site to the empty site with the largest ratio
+    int spin = 0;
+    double best = 0.0;
+    for (int s=0; s<config.num_sites_; ++s) {
+      if (up_occupied[s]) continue;
+      config.wf_.get_amplitudes(config.psi_row_, s, dn_sites);
+      double r = std::abs(config.psi_row_.cwiseProduct(config.psi_inv_.col(spin)).sum());
+      if (r > best) { best = r; row_to = config.psi_row_; }
+    }
+    config.wf_.get_amplitudes(row_fr, up_sites[spin], dn_sites);
+    ns = 0.5*time_op([&]() {
+      amplitude_t r = row_to.cwiseProduct(config.psi_inv_.col(spin)).sum();
+      config.inv_update_upspin(spin, row_to, r);
+      r = row_fr.cwiseProduct(config.psi_inv_.col(spin)).sum();
+      config.inv_update_upspin(spin, row_fr, r); }, iters);
+    // per column: dot (read) + axpy (read & write)
+    add("inv_update_upspin", "complex", 3*16*nd*nd, 16*nd*nd);
+    best = 0.0;
+    for (int s=0; s<config.num_sites_; ++s) {
+      if (dn_occupied[s]) continue;
+      config.wf_.get_amplitudes(config.psi_col_, up_sites, s);
+      double r = std::abs(config.psi_col_.cwiseProduct(config.psi_inv_.row(spin)).sum());
+      if (r > best) { best = r; col_to = config.psi_col_; }
+    }
+    config.wf_.get_amplitudes(col_fr, up_sites, dn_sites[spin]);
+    ns = 0.5*time_op([&]() {
+      amplitude_t r = col_to.cwiseProduct(config.psi_inv_.row(spin)).sum();
+      config.inv_update_dnspin(spin, col_to, r);
+      r = col_fr.cwiseProduct(config.psi_inv_.row(spin)).sum();
+      config.inv_update_dnspin(spin, col_fr, r); }, iters);
+    add("inv_update_dnspin", "complex", 3*16*nd*nd, 16*nd*nd);
+    config.refresh_inverse();
+  }
+
+  //------- local energy: one determinant ratio per possible hop
+  {
+    long num_hops = 0;
+    op_move mv;
+    for (int i=0; i<config.lattice_.num_bonds(); ++i) {
+      int src = config.lattice_.bond_src()[i];
+      int tgt = config.lattice_.bond_tgt()[i];
+      if (config.basis_state_.op_cdagc_up(src,tgt,mv)) num_hops++;
+      if (config.basis_state_.op_cdagc_dn(src,tgt,mv)) num_hops++;
+    }
+    double energy = 0.0;
+    ns = time_op([&]() { energy += config.get_energy(); }, iters);
+    add("get_energy", "complex", num_hops*2*16*nd, num_hops*8*nd);
+    sink = energy;
+  }
+
+  //------- move proposal
+  {
+    ns = time_op([&]() {
+      if (config.basis_state_.gen_upspin_hop()) config.basis_state_.undo_last_move(); }, iters);
+    add("gen_upspin_hop", "-", 0.0, 0.0);
+  }
+
+  //------- amplitude table: k-sum per displacement & the N^2 table
+  {
+    RealVector vparams = RealVector::Ones(config.num_vparams());
+    ns = time_op([&]() { config.wf_.compute(config.lattice_, vparams, 0); }, iters);
+    double num_disp = (2.0*L-1)*(2.0*L-1);
+    double num_k = config.lattice_.num_kpoints();
+    double N = config.num_sites_;
+    add("compute_BCS", "complex", 16*N*N, 8*num_disp*num_k);
+  }
+}
+
+int main(int argc, const char *argv[])
+{
+  std::vector<double> sizes;
+  double min_time;
+  std::string json_file;
+  try {
+    input::Parameters inputs(argc, argv);
+    sizes = inputs.set_vector("sizes", {4, 8, 16, 32, 64});
+    min_time = inputs.set_value("min_time", 0.2);
+    json_file = inputs.set_value("json", "bench.json");
+    if (!inputs.unused().empty())
+      throw std::invalid_argument("bench: unknown input parameter "+inputs.unused()[0]);
+  }
+  catch (const std::exception& e) {
+    std::cout << e.what() << "\n";
+    return 1;
+  }
+
+  KernelBench bench(min_time);
+  std::vector<bench_result> results;
+  std::cout << std::left << std::setw(20) << "kernel" << std::setw(9) << "type"
+    << std::right << std::setw(5) << "L" << std::setw(14) << "ns/op"
+    << std::setw(11) << "GB/s" << std::setw(11) << "GFlop/s" << "\n";
+  for (double x : sizes) {
+    int L = static_cast<int>(x);
+    std::size_t first = results.size();
+    bench.run(L, results);
+    for (std::size_t i=first; i<results.size(); ++i) {
+      const bench_result& r = results[i];
+      std::cout << std::left << std::setw(20) << r.kernel << std::setw(9) << r.type
+        << std::right << std::setw(5) << r.L << std::fixed << std::setprecision(1)
+        << std::setw(14) << r.ns_per_op << std::setprecision(2)
+        << std::setw(11) << r.bytes_per_op/r.ns_per_op
+        << std::setw(11) << r.flops_per_op/r.ns_per_op << "\n";
+      std::cout.unsetf(std::ios_base::floatfield);
+    }
+  }
+
+  if (!json_file.empty()) {
+    std::ostringstream os;
+    os << std::setprecision(6);
+    os << "{\n  \"benchmarks\": [\n";
+    for (std::size_t i=0; i<results.size(); ++i) {
+      const bench_result& r = results[i];
+      os << "    {\"kernel\": \"" << r.kernel << "\", \"type\": \"" << r.type
+        << "\", \"L\": " << r.L << ", \"iterations\": " << r.iterations
+        << ", \"ns_per_op\": " << r.ns_per_op << ", \"bytes_per_op\": " << r.bytes_per_op
+        << ", \"flops_per_op\": " << r.flops_per_op << ", \"gb_per_s\": "
+        << r.bytes_per_op/r.ns_per_op << ", \"gflop_per_s\": "
+        << r.flops_per_op/r.ns_per_op << "}" << (i+1<results.size() ? "," : "") << "\n";
+    }
+    os << "  ]\n}\n";
+    std::ofstream fs(json_file);
+    fs << os.str();
+    if (!fs) {
+      std::cout << "bench: can't write " << json_file << "\n";
+      return 1;
+    }
+  }
+  return 0;
+}
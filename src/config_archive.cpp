@@ -0,0 +1,157 @@
+// File: config_archive.cpp
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "config_archive.h"
+
+namespace {
+const char archive_magic[8] = {'V','M','C','C','F','G','0','1'};
+const std::uint32_t archive_version = 1;
+const std::size_t header_size = 8+6*sizeof(std::uint32_t);
+
+struct archive_header
+{
+  std::uint32_t version;
+  std::uint32_t num_sites;
+  std::uint32_t num_upspins;
+  std::uint32_t num_dnspins;
+  std::uint32_t num_words;
+  std::uint32_t zero;
+};
+}
+
+/*----------------------ConfigArchive class------------------*/
+void ConfigArchive::open(const std::string& fname, const FockBasis& basis, 
+  const std::vector<int>& canonical_site)
+{
+  close();
+  fname_ = fname;
+  num_states_ = basis.state().size();
+  if (!canonical_site.empty() && 2*canonical_site.size()!=num_states_) 
+    throw std::invalid_argument("ConfigArchive::open: site map size mismatch");
+  canonical_site_ = canonical_site;
+  archive_header header;
+  header.version = archive_version;
+  header.num_sites = num_states_/2;
+  header.num_upspins = basis.upspin_sites().size();
+  header.num_dnspins = basis.dnspin_sites().size();
+  header.num_words = (num_states_+63)/64;
+  header.zero = 0;
+  record_.resize(1+header.num_words);
+  std::size_t record_size = sizeof(std::uint64_t)*record_.size();
+
+  // existing archive?
+  num_records_ = 0;
+  struct stat st;
+  bool append = (stat(fname_.c_str(), &st)==0 && st.st_size>0);
+  if (append) {
+    char magic[8];
+    archive_header old;
+    std::FILE* fs = std::fopen(fname_.c_str(), "rb");
+    bool ok = (fs != nullptr);
+    ok = ok && std::fread(magic, 1, 8, fs)==8 && std::fread(&old, sizeof(old), 1, fs)==1;
+    if (fs != nullptr) std::fclose(fs);
+    if (!ok || std::memcmp(magic, archive_magic, 8)!=0 || 
+      std::memcmp(&old, &header, sizeof(header))!=0) {
+      throw std::runtime_error("ConfigArchive::open: '"+fname_+"' is not an archive of this system");
+    }
+    num_records_ = (st.st_size-header_size)/record_size;
+    off_t complete_size = header_size + num_records_*record_size;
+    if (st.st_size != complete_size && truncate(fname_.c_str(), complete_size) != 0)
+      throw std::runtime_error("ConfigArchive::open: failed to truncate '"+fname_+"'");
+  }
+  fs_ = std::fopen(fname_.c_str(), "ab");
+  if (fs_ == nullptr) throw std::runtime_error("ConfigArchive::open: file open failed");
+  io_buffer_.resize(1<<16);
+  std::setvbuf(fs_, io_buffer_.data(), _IOFBF, io_buffer_.size());
+  if (!append) {
+    if (std::fwrite(archive_magic, 1, 8, fs_)!=8 || std::fwrite(&header, sizeof(header), 1, fs_)!=1)
+      throw std::runtime_error("ConfigArchive::open: write failed for '"+fname_+"'");
+  }
+}
+
+void ConfigArchive::append(const FockBasis& basis, const std::uint64_t& sweep)
+{
+  const ivector& state = basis.state();
+  if (state.size() != num_states_) 
+    throw std::invalid_argument("ConfigArchive::append: basis size mismatch");
+  record_[0] = sweep;
+  for (std::size_t i=1; i<record_.size(); ++i) record_[i] = 0;
+  unsigned num_sites = num_states_/2;
+  for (unsigned s=0; s<num_states_; ++s) {
+    if (!state[s]) continue;
+    unsigned t = s;
+    if (!canonical_site_.empty()) {
+      t = (s<num_sites) ? canonical_site_[s] : num_sites+canonical_site_[s-num_sites];
+    }
+    record_[1+t/64] |= std::uint64_t(1) << (t%64);
+  }
+  if (std::fwrite(record_.data(), sizeof(std::uint64_t), record_.size(), fs_) != record_.size())
+    throw std::runtime_error("ConfigArchive::append: write failed for '"+fname_+"'");
+  ++num_records_;
+}
+
+void ConfigArchive::close(void)
+{
+  if (fs_ == nullptr) return;
+  std::fclose(fs_);
+  fs_ = nullptr;
+}
+
+/*----------------------ConfigArchiveReader class------------------*/
+void ConfigArchiveReader::open(const std::string& fname)
+{
+  close();
+  int fd = ::open(fname.c_str(), O_RDONLY);
+  if (fd < 0) throw std::runtime_error("ConfigArchiveReader::open: file open failed");
+  struct stat st;
+  if (fstat(fd, &st)!=0 || static_cast<std::size_t>(st.st_size)<header_size) {
+    ::close(fd);
+    throw std::runtime_error("ConfigArchiveReader::open: '"+fname+"' is not an archive");
+  }
+  map_size_ = st.st_size;
+  void* p = mmap(nullptr, map_size_, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED) throw std::runtime_error("ConfigArchiveReader::open: mmap failed");
+  map_ = static_cast<const unsigned char*>(p);
+  archive_header header;
+  std::memcpy(&header, map_+8, sizeof(header));
+  if (std::memcmp(map_, archive_magic, 8)!=0 || header.version!=archive_version) {
+    close();
+    throw std::runtime_error("ConfigArchiveReader::open: '"+fname+"' is not an archive");
+  }
+  num_sites_ = header.num_sites;
+  num_upspins_ = header.num_upspins;
+  num_dnspins_ = header.num_dnspins;
+  num_words_ = header.num_words;
+  // an incomplete last record is ignored
+  num_records_ = (map_size_-header_size)/(sizeof(std::uint64_t)*(1+num_words_));
+}
+
+void ConfigArchiveReader::close(void)
+{
+  if (map_ != nullptr) munmap(const_cast<unsigned char*>(map_), map_size_);
+  map_ = nullptr;
+  map_size_ = 0;
+  num_records_ = 0;
+}
+
+std::uint64_t ConfigArchiveReader::read(const std::uint64_t& n, ivector& state) const
+{
+  if (n >= num_records_) throw std::range_error("ConfigArchiveReader::read: no such record");
+  const unsigned char* q = map_+header_size+n*sizeof(std::uint64_t)*(1+num_words_);
+  std::uint64_t sweep;
+  std::memcpy(&sweep, q, sizeof(sweep));
+  q += sizeof(sweep);
+  state.resize(2*num_sites_);
+  for (unsigned w=0; w<num_words_; ++w) {
+    std::uint64_t word;
+    std::memcpy(&word, q+w*sizeof(word), sizeof(word));
+    for (unsigned s=64*w; s<std::min(64*(w+1), 2*num_sites_); ++s) 
+      state[s] = (word >> (s%64)) & 1;
+  }
+  return sweep;
+}
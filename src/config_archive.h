@@ -0,0 +1,75 @@
+// File: config_archive.h
+#ifndef CONFIG_ARCHIVE_H
+#define CONFIG_ARCHIVE_H
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "basis.h"
+
+/*---------------------------------------------------------------------------
+* Append-only archive of sampled basis states, for re-evaluating observables
+* offline without repeating the Markov chain. Fixed size records, so any 
+* record can be read directly. File layout (little endian):
+*   header: "VMCCFG01", u32 version, u32 num_sites, u32 num_upspins, 
+*           u32 num_dnspins, u32 num_words, u32 0
+*   record: u64 sweep index, then 'num_words' u64 words holding the 
+*           occupancy of state 's' (UP states first) in bit s%64 of word s/64
+* States are stored in the canonical (ROW_MAJOR) site numbering if a site 
+* map is given, so that archives do not depend on the site order of a run.
+* A partly written last record (interrupted run) is dropped on reopening.
+*----------------------------------------------------------------------------*/
+class ConfigArchive
+{
+public:
+  ConfigArchive() {}
+  ~ConfigArchive() { close(); }
+  // appends to an existing archive of the same system; 'canonical_site' 
+  // (e.g. Lattice::canonical_sites()) maps site indices to the canonical ones
+  void open(const std::string& fname, const FockBasis& basis, 
+    const std::vector<int>& canonical_site=std::vector<int>());
+  void close(void);
+  bool is_open(void) const { return fs_ != nullptr; }
+  void append(const FockBasis& basis, const std::uint64_t& sweep);
+  const std::uint64_t& num_records(void) const { return num_records_; }
+private:
+  std::FILE* fs_{nullptr};
+  std::string fname_;
+  unsigned num_states_{0};
+  std::uint64_t num_records_{0};
+  std::vector<std::uint64_t> record_;
+  std::vector<int> canonical_site_;
+  std::vector<char> io_buffer_;
+};
+
+/*---------------------------------------------------------------------------
+* Reads a ConfigArchive through a read-only memory map ('read' is const and 
+* may be called from several threads at once)
+*----------------------------------------------------------------------------*/
+class ConfigArchiveReader
+{
+public:
+  ConfigArchiveReader() {}
+  ConfigArchiveReader(const std::string& fname) { open(fname); }
+  ~ConfigArchiveReader() { close(); }
+  void open(const std::string& fname);
+  void close(void);
+  const unsigned& num_sites(void) const { return num_sites_; }
+  const unsigned& num_upspins(void) const { return num_upspins_; }
+  const unsigned& num_dnspins(void) const { return num_dnspins_; }
+  const std::uint64_t& num_records(void) const { return num_records_; }
+  // basis state occupancies of record 'n', returns its sweep index
+  std::uint64_t read(const std::uint64_t& n, ivector& state) const;
+private:
+  const unsigned char* map_{nullptr};
+  std::size_t map_size_{0};
+  unsigned num_sites_{0};
+  unsigned num_upspins_{0};
+  unsigned num_dnspins_{0};
+  unsigned num_words_{0};
+  std::uint64_t num_records_{0};
+};
+
+
+#endif
@@ -0,0 +1,163 @@
+// File: hw_counters.cpp
+#include "hw_counters.h"
+
+#if defined(VMC_PERF_COUNTERS) && defined(__linux__)
+#define HW_COUNTERS_LINUX
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+namespace instrument {
+
+const char* HwCounters::name(const hw_event& e)
+{
+  switch (e) {
+    case hw_event::CYCLES: return "cycles";
+    case hw_event::INSTRUCTIONS: return "instructions";
+    case hw_event::LLC_MISSES: return "llc_misses";
+    case hw_event::BRANCH_MISSES: return "branch_misses";
+  }
+  return "";
+}
+
+HwCounters& HwCounters::this_thread(void)
+{
+  thread_local HwCounters counters;
+  if (!counters.tried_) counters.open();
+  return counters;
+}
+
+#ifdef HW_COUNTERS_LINUX
+
+namespace {
+
+const std::uint64_t event_config[num_hw_events] = {PERF_COUNT_HW_CPU_CYCLES,
+  PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+#if defined(__x86_64__) || defined(__i386__)
+inline std::uint64_t rdpmc(const unsigned& counter)
+{
+  unsigned lo, hi;
+  __asm__ volatile("rdpmc" : "=a"(lo), "=d"(hi) : "c"(counter));
+  return (static_cast<std::uint64_t>(hi)<<32) | lo;
+}
+#endif
+
+inline void compiler_barrier(void) { __asm__ volatile("" ::: "memory"); }
+
+} // end anonymous namespace
+
+bool HwCounters::open(void)
+{
+  close();
+  tried_ = true;
+  long page_size = sysconf(_SC_PAGESIZE);
+  for (int i=0; i<num_hw_events; ++i) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = event_config[i];
+    // the group starts once it is complete
+    attr.disabled = (leader_<0) ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    int fd = syscall(__NR_perf_event_open, &attr, 0, -1, leader_, 0);
+    if (fd < 0) continue;
+    if (leader_ < 0) leader_ = fd;
+    fd_[i] = fd;
+    num_open_++;
+    void* page = mmap(nullptr, page_size, PROT_READ, MAP_SHARED, fd, 0);
+    page_[i] = (page==MAP_FAILED) ? nullptr : page;
+  }
+  if (leader_ < 0) return false;
+  ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#if defined(__x86_64__) || defined(__i386__)
+  use_rdpmc_ = true;
+  for (int i=0; i<num_hw_events; ++i) {
+    if (fd_[i] < 0) continue;
+    const perf_event_mmap_page* pc = static_cast<const perf_event_mmap_page*>(page_[i]);
+    if (!pc || !pc->cap_user_rdpmc) use_rdpmc_ = false;
+  }
+#endif
+  return true;
+}
+
+void HwCounters::close(void)
+{
+  long page_size = sysconf(_SC_PAGESIZE);
+  for (int i=0; i<num_hw_events; ++i) {
+    if (page_[i]) munmap(page_[i], page_size);
+    if (fd_[i] >= 0) ::close(fd_[i]);
+    page_[i] = nullptr;
+    fd_[i] = -1;
+  }
+  leader_ = -1;
+  num_open_ = 0;
+  use_rdpmc_ = false;
+}
+
+void HwCounters::read(std::uint64_t* counts) const
+{
+  for (int i=0; i<num_hw_events; ++i) counts[i] = 0;
+  if (num_open_ == 0) return;
+#if defined(__x86_64__) || defined(__i386__)
+  if (use_rdpmc_) {
+    // self-monitoring read of 'perf_event_open(2)', retried while the
+    // kernel updates the page; an event off the PMU needs the syscall
+    for (int i=0; i<num_hw_events; ++i) {
+      if (fd_[i] < 0) continue;
+      const perf_event_mmap_page* pc = static_cast<const perf_event_mmap_page*>(page_[i]);
+      std::uint32_t seq;
+      std::uint64_t count;
+      do {
+        seq = pc->lock;
+        compiler_barrier();
+        std::uint32_t index = pc->index;
+        if (index == 0) { read_group(counts); return; }
+        std::uint16_t width = pc->pmc_width;
+        std::int64_t pmc = rdpmc(index-1);
+        pmc <<= 64-width;
+        pmc >>= 64-width;
+        count = pc->offset + pmc;
+        compiler_barrier();
+      } while (pc->lock != seq);
+      counts[i] = count;
+    }
+    return;
+  }
+#endif
+  read_group(counts);
+}
+
+void HwCounters::read_group(std::uint64_t* counts) const
+{
+  // PERF_FORMAT_GROUP: the number of events, then their values in the
+  // order they were opened
+  std::uint64_t buffer[1+num_hw_events];
+  if (::read(leader_, buffer, sizeof(buffer)) < static_cast<long>(sizeof(std::uint64_t))) return;
+  int n = 0;
+  for (int i=0; i<num_hw_events && n<static_cast<int>(buffer[0]); ++i) {
+    if (fd_[i] >= 0) counts[i] = buffer[1+n++];
+  }
+}
+
+#else
+
+bool HwCounters::open(void) { tried_ = true; return false; }
+void HwCounters::close(void) {}
+void HwCounters::read(std::uint64_t* counts) const
+{
+  for (int i=0; i<num_hw_events; ++i) counts[i] = 0;
+}
+void HwCounters::read_group(std::uint64_t* counts) const {}
+
+#endif
+
+} // end namespace instrument
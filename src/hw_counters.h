@@ -0,0 +1,48 @@
+// File: hw_counters.h
+#ifndef HW_COUNTERS_H
+#define HW_COUNTERS_H
+
+#include <cstdint>
+
+namespace instrument {
+
+enum class hw_event {CYCLES, INSTRUCTIONS, LLC_MISSES, BRANCH_MISSES};
+constexpr int num_hw_events = 4;
+
+/*---------------------------------------------------------------------------
+* Hardware event counters of the calling thread, through Linux perf events
+* ('perf_event_open', user space only). The events are opened as one group
+* and read with 'rdpmc' from the mmapped event pages where the kernel allows
+* it, else with a single 'read' of the group. Events the machine (or the VM)
+* does not provide are left out; with none of them, or when not compiled
+* with VMC_PERF_COUNTERS on Linux, 'available' is false and counts are 0.
+*----------------------------------------------------------------------------*/
+class HwCounters
+{
+public:
+  HwCounters() {}
+  ~HwCounters() { close(); }
+  HwCounters(const HwCounters&) = delete;
+  HwCounters& operator=(const HwCounters&) = delete;
+  bool open(void);
+  void close(void);
+  bool available(void) const { return num_open_ > 0; }
+  bool available(const hw_event& e) const { return fd_[static_cast<int>(e)] >= 0; }
+  // running counts, 'num_hw_events' of them
+  void read(std::uint64_t* counts) const;
+  // of the calling thread, opened on first use
+  static HwCounters& this_thread(void);
+  static const char* name(const hw_event& e);
+private:
+  int fd_[num_hw_events]{-1,-1,-1,-1};
+  void* page_[num_hw_events]{nullptr,nullptr,nullptr,nullptr};
+  int leader_{-1};
+  int num_open_{0};
+  bool use_rdpmc_{false};
+  bool tried_{false};
+  void read_group(std::uint64_t* counts) const;
+};
+
+} // end namespace instrument
+
+#endif
@@ -0,0 +1,131 @@
+// File: input.cpp
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include "input.h"
+
+namespace input {
+
+void Parameters::init(const int& argc, const char* argv[])
+{
+  values_.clear();
+  used_.clear();
+  std::vector<std::pair<std::string,std::string> > overrides;
+  for (int i=1; i<argc; ++i) {
+    std::string arg(argv[i]);
+    std::size_t pos = arg.find('=');
+    if (pos == std::string::npos) {
+      if (i>1) throw std::invalid_argument("Parameters::init: '"+arg+"' is not 'name=value'");
+      read_file(arg);
+    }
+    else overrides.push_back({trim(arg.substr(0,pos)), trim(arg.substr(pos+1))});
+  }
+  for (const auto& p : overrides) set(p.first, p.second);
+}
+
+void Parameters::read_file(const std::string& fname)
+{
+  std::ifstream fs(fname);
+  if (!fs.is_open()) throw std::runtime_error("Parameters::read_file: can't open '"+fname+"'");
+  std::string line;
+  int lnum = 0;
+  while (std::getline(fs, line)) {
+    ++lnum;
+    line = trim(line.substr(0, line.find('#')));
+    if (line.empty()) continue;
+    std::size_t pos = line.find('=');
+    if (pos == std::string::npos) {
+      throw std::invalid_argument("Parameters::read_file: "+fname+":"+std::to_string(lnum)
+        +": expected 'name = value'");
+    }
+    set(trim(line.substr(0,pos)), trim(line.substr(pos+1)));
+  }
+}
+
+const std::string* Parameters::find(const std::string& name) const
+{
+  auto it = values_.find(name);
+  if (it == values_.end()) return nullptr;
+  used_.insert(name);
+  return &it->second;
+}
+
+int Parameters::set_value(const std::string& name, const int& defval) const
+{
+  const std::string* value = find(name);
+  if (!value) return defval;
+  std::size_t n;
+  int x;
+  try { x = std::stoi(*value, &n); }
+  catch (const std::exception&) { n = 0; }
+  if (n==0 || n!=value->size()) 
+    throw std::invalid_argument("Parameters::set_value: '"+name+"' is not an integer");
+  return x;
+}
+
+double Parameters::set_value(const std::string& name, const double& defval) const
+{
+  const std::string* value = find(name);
+  if (!value) return defval;
+  std::size_t n;
+  double x;
+  try { x = std::stod(*value, &n); }
+  catch (const std::exception&) { n = 0; }
+  if (n==0 || n!=value->size()) 
+    throw std::invalid_argument("Parameters::set_value: '"+name+"' is not a number");
+  return x;
+}
+
+bool Parameters::set_value(const std::string& name, const bool& defval) const
+{
+  const std::string* value = find(name);
+  if (!value) return defval;
+  std::string v(*value);
+  std::transform(v.begin(), v.end(), v.begin(), ::tolower);
+  if (v=="1" || v=="true" || v=="yes" || v=="on") return true;
+  if (v=="0" || v=="false" || v=="no" || v=="off") return false;
+  throw std::invalid_argument("Parameters::set_value: '"+name+"' is not a boolean");
+}
+
+std::string Parameters::set_value(const std::string& name, const std::string& defval) const
+{
+  const std::string* value = find(name);
+  return value ? *value : defval;
+}
+
+std::vector<double> Parameters::set_vector(const std::string& name, 
+  const std::vector<double>& defval) const
+{
+  const std::string* value = find(name);
+  if (!value) return defval;
+  std::string v(*value);
+  std::replace(v.begin(), v.end(), ',', ' ');
+  std::istringstream is(v);
+  std::vector<double> x;
+  std::string item;
+  while (is >> item) {
+    std::size_t n;
+    try { x.push_back(std::stod(item, &n)); }
+    catch (const std::exception&) { n = 0; }
+    if (n==0 || n!=item.size()) 
+      throw std::invalid_argument("Parameters::set_vector: '"+name+"' is not a list of numbers");
+  }
+  return x;
+}
+
+std::vector<std::string> Parameters::unused(void) const
+{
+  std::vector<std::string> names;
+  for (const auto& p : values_) if (used_.find(p.first)==used_.end()) names.push_back(p.first);
+  return names;
+}
+
+std::string Parameters::trim(const std::string& s)
+{
+  std::size_t first = s.find_first_not_of(" \t\r");
+  if (first == std::string::npos) return "";
+  std::size_t last = s.find_last_not_of(" \t\r");
+  return s.substr(first, last-first+1);
+}
+
+} // end namespace input
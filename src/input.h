@@ -0,0 +1,50 @@
+// File: input.h
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <stdexcept>
+
+namespace input {
+
+/*---------------------------------------------------------------------------
+* Run parameters, from an input file of lines 
+*   name = value    # comment
+* and from the command line, 'prog [input_file] [name=value ...]', where the
+* command line values override those of the file. Values are read with 
+* 'set_value(name, default)'; names never read are reported by 'unused' 
+* (misspelled parameters).
+*----------------------------------------------------------------------------*/
+class Parameters 
+{
+public:
+  Parameters() {}
+  Parameters(const int& argc, const char* argv[]) { init(argc, argv); }
+  ~Parameters() {}
+  void init(const int& argc, const char* argv[]);
+  void read_file(const std::string& fname);
+  void set(const std::string& name, const std::string& value) { values_[name] = value; }
+  bool have(const std::string& name) const { return values_.find(name)!=values_.end(); }
+  int set_value(const std::string& name, const int& defval) const;
+  double set_value(const std::string& name, const double& defval) const;
+  bool set_value(const std::string& name, const bool& defval) const;
+  std::string set_value(const std::string& name, const std::string& defval) const;
+  std::string set_value(const std::string& name, const char* defval) const
+    { return set_value(name, std::string(defval)); }
+  // comma (or blank) separated list
+  std::vector<double> set_vector(const std::string& name, 
+    const std::vector<double>& defval) const;
+  std::vector<std::string> unused(void) const;
+private:
+  std::map<std::string, std::string> values_;
+  mutable std::set<std::string> used_;
+  const std::string* find(const std::string& name) const;
+  static std::string trim(const std::string& s);
+};
+
+} // end namespace input
+
+#endif
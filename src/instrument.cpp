@@ -0,0 +1,167 @@
+// File: instrument.cpp
+#include <iomanip>
+#include <algorithm>
+#include "instrument.h"
+
+namespace instrument {
+
+const char* phase_name(const phase& p)
+{
+  switch (p) {
+    case phase::PROPOSE: return "propose";
+    case phase::GATHER: return "gather";
+    case phase::RATIO: return "ratio";
+    case phase::INV_UPDATE: return "inv_update";
+    case phase::REFRESH: return "refresh";
+    case phase::MEASURE: return "measure";
+    case phase::IO: return "io";
+  }
+  return "";
+}
+
+const char* move_name(const move& m)
+{
+  switch (m) {
+    case move::UPSPIN_HOP: return "upspin_hop";
+    case move::DNSPIN_HOP: return "dnspin_hop";
+  }
+  return "";
+}
+
+void Profile::reset(void)
+{
+  for (int i=0; i<num_phases; ++i) { ticks_[i] = 0; calls_[i] = 0; }
+  for (int i=0; i<num_phases; ++i)
+    for (int k=0; k<num_hw_events; ++k) hw_counts_[i][k] = 0;
+  hw_ = nullptr;
+#ifdef VMC_PERF_COUNTERS
+  const HwCounters& hw = HwCounters::this_thread();
+  if (hw.available()) hw_ = &hw;
+#endif
+  for (int k=0; k<num_hw_events; ++k) hw_mark_[k] = 0;
+  if (hw_) hw_->read(hw_mark_);
+  for (int m=0; m<num_moves; ++m)
+    for (int e=0; e<num_events; ++e) counts_[m][e] = 0;
+  active_ = -1;
+  mark_ = 0;
+  start_ticks_ = ticks();
+  start_time_ = std::chrono::steady_clock::now();
+}
+
+void Profile::add(const Profile& other)
+{
+  // the wall time stays the one of this profile
+  for (int i=0; i<num_phases; ++i) {
+    ticks_[i] += other.ticks_[i];
+    calls_[i] += other.calls_[i];
+    for (int k=0; k<num_hw_events; ++k) hw_counts_[i][k] += other.hw_counts_[i][k];
+  }
+  for (int m=0; m<num_moves; ++m)
+    for (int e=0; e<num_events; ++e) counts_[m][e] += other.counts_[m][e];
+}
+
+double Profile::ticks_per_second(void) const
+{
+  double dt = wall_seconds();
+  if (dt <= 0.0) return 1.0;
+  return (ticks()-start_ticks_)/dt;
+}
+
+double Profile::wall_seconds(void) const
+{
+  std::chrono::duration<double> dt = std::chrono::steady_clock::now()-start_time_;
+  return dt.count();
+}
+
+double Profile::seconds(const phase& p) const
+{
+  return ticks_[static_cast<int>(p)]/ticks_per_second();
+}
+
+void Profile::write_json(std::ostream& os) const
+{
+  double wall = wall_seconds();
+  double rate = ticks_per_second();
+  double timed = 0.0;
+  std::streamsize dp = os.precision();
+  os << std::setprecision(6);
+  os << "{\n  \"instrumented\": " << (enabled ? "true" : "false") << ",\n";
+  os << "  \"wall_seconds\": " << wall << ",\n";
+  os << "  \"ticks_per_second\": " << rate << ",\n";
+  os << "  \"phases\": {\n";
+  for (int i=0; i<num_phases; ++i) {
+    double t = ticks_[i]/rate;
+    timed += t;
+    os << "    \"" << phase_name(static_cast<phase>(i)) << "\": {\"calls\": " << calls_[i]
+       << ", \"seconds\": " << t << ", \"fraction\": " << (wall>0.0 ? t/wall : 0.0) << "},\n";
+  }
+  double rest = std::max(wall-timed, 0.0);
+  os << "    \"other\": {\"seconds\": " << rest << ", \"fraction\": "
+     << (wall>0.0 ? rest/wall : 0.0) << "}\n  },\n";
+  os << "  \"moves\": {\n";
+  for (int m=0; m<num_moves; ++m) {
+    const std::uint64_t* c = counts_[m];
+    std::uint64_t proposed = c[static_cast<int>(event::PROPOSED)];
+    std::uint64_t accepted = c[static_cast<int>(event::ACCEPTED)];
+    os << "    \"" << move_name(static_cast<move>(m)) << "\": {\"proposed\": " << proposed
+       << ", \"accepted\": " << accepted << ", \"nodal_rejected\": "
+       << c[static_cast<int>(event::NODAL_REJECTED)] << ", \"acceptance\": "
+       << (proposed>0 ? double(accepted)/proposed : 0.0) << "}"
+       << (m+1<num_moves ? "," : "") << "\n";
+  }
+  os << "  },\n";
+  os << "  \"refreshes\": " << calls_[static_cast<int>(phase::REFRESH)] << ",\n";
+  write_hw_json(os);
+  os << "}\n";
+  os << std::setprecision(dp);
+}
+
+void Profile::write_hw_json(std::ostream& os) const
+{
+  os << "  \"hardware_counters\": ";
+  if (!hw_) {
+    os << "null\n";
+    return;
+  }
+  // events the machine does not count are null
+  auto write_counts = [&](const double* c) 
+  {
+    for (int k=0; k<num_hw_events; ++k) {
+      hw_event e = static_cast<hw_event>(k);
+      os << "\"" << HwCounters::name(e) << "\": ";
+      if (hw_->available(e)) os << c[k]; 
+      else os << "null";
+      os << ", ";
+    }
+    const double& cycles = c[static_cast<int>(hw_event::CYCLES)];
+    os << "\"ipc\": ";
+    if (hw_->available(hw_event::CYCLES) && hw_->available(hw_event::INSTRUCTIONS) 
+      && cycles>0.0) os << c[static_cast<int>(hw_event::INSTRUCTIONS)]/cycles;
+    else os << "null";
+  };
+  // counts in full
+  std::streamsize dp = os.precision(12);
+  double c[num_hw_events];
+  os << "{\n    \"phases\": {\n";
+  for (int i=0; i<num_phases; ++i) {
+    for (int k=0; k<num_hw_events; ++k) c[k] = hw_counts_[i][k];
+    os << "      \"" << phase_name(static_cast<phase>(i)) << "\": {";
+    write_counts(c);
+    os << "}" << (i+1<num_phases ? "," : "") << "\n";
+  }
+  os << "    },\n";
+  // the sampling phases per proposed move
+  double num_proposed = 0.0;
+  for (int m=0; m<num_moves; ++m) num_proposed += counts_[m][static_cast<int>(event::PROPOSED)];
+  for (int k=0; k<num_hw_events; ++k) {
+    c[k] = 0.0;
+    for (int i=0; i<=static_cast<int>(phase::REFRESH); ++i) c[k] += hw_counts_[i][k];
+    if (num_proposed > 0.0) c[k] /= num_proposed;
+  }
+  os << "    \"per_move\": {";
+  write_counts(c);
+  os << "}\n  }\n";
+  os.precision(dp);
+}
+
+} // end namespace instrument
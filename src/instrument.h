@@ -0,0 +1,147 @@
+// File: instrument.h
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <cstdint>
+#include <chrono>
+#include <iostream>
+#include "hw_counters.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*---------------------------------------------------------------------------
+* Hot-path instrumentation, compiled in with '-DVMC_INSTRUMENT'. The phases
+* of a run are timed with the time stamp counter,
+*   INSTRUMENT_PHASE(profile, GATHER);   // to the end of the scope
+* and the moves are counted,
+*   INSTRUMENT_COUNT(profile, UPSPIN_HOP, ACCEPTED);
+* Phase times are exclusive: a nested phase pauses the enclosing one.
+* Without VMC_INSTRUMENT both macros expand to nothing. A Profile is
+* meant for one thread (one per SysConfig/VMC); they are merged with 'add'.
+* With VMC_PERF_COUNTERS as well, the hardware counters of the thread (see
+* HwCounters) are read at the phase boundaries too and the report gets
+* per-phase cycles, instructions, LLC & branch misses and the IPC, and the
+* same per proposed move.
+*----------------------------------------------------------------------------*/
+namespace instrument {
+
+enum class phase {PROPOSE, GATHER, RATIO, INV_UPDATE, REFRESH, MEASURE, IO};
+enum class move {UPSPIN_HOP, DNSPIN_HOP};
+enum class event {PROPOSED, ACCEPTED, NODAL_REJECTED};
+constexpr int num_phases = 7;
+constexpr int num_moves = 2;
+constexpr int num_events = 3;
+
+#ifdef VMC_INSTRUMENT
+constexpr bool enabled = true;
+#else
+constexpr bool enabled = false;
+#endif
+
+// time stamp counter (steady clock ticks where there is none)
+inline std::uint64_t ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+class Profile
+{
+public:
+  Profile() { reset(); }
+  ~Profile() {}
+  void reset(void);
+  // returns the phase that was running (-1 if none), to be passed to 'leave'
+  int enter(const phase& p)
+  {
+    std::uint64_t t = ticks();
+    if (active_ >= 0) ticks_[active_] += t-mark_;
+#ifdef VMC_PERF_COUNTERS
+    sample_hw();
+#endif
+    int parent = active_;
+    active_ = static_cast<int>(p);
+    calls_[active_]++;
+    mark_ = t;
+    return parent;
+  }
+  void leave(const int& parent)
+  {
+    std::uint64_t t = ticks();
+    ticks_[active_] += t-mark_;
+#ifdef VMC_PERF_COUNTERS
+    sample_hw();
+#endif
+    active_ = parent;
+    mark_ = t;
+  }
+  void count(const move& m, const event& e)
+    { counts_[static_cast<int>(m)][static_cast<int>(e)]++; }
+  void add(const Profile& other);
+  const std::uint64_t& calls(const phase& p) const { return calls_[static_cast<int>(p)]; }
+  double seconds(const phase& p) const;
+  double wall_seconds(void) const;
+  const std::uint64_t& count(const move& m, const event& e) const
+    { return counts_[static_cast<int>(m)][static_cast<int>(e)]; }
+  void write_json(std::ostream& os) const;
+private:
+  std::uint64_t ticks_[num_phases];
+  std::uint64_t calls_[num_phases];
+  std::uint64_t counts_[num_moves][num_events];
+  int active_;
+  std::uint64_t mark_;
+  // hardware events per phase (VMC_PERF_COUNTERS builds)
+  const HwCounters* hw_;
+  std::uint64_t hw_counts_[num_phases][num_hw_events];
+  std::uint64_t hw_mark_[num_hw_events];
+  // counts since the last boundary go to the active phase
+  void sample_hw(void)
+  {
+    if (!hw_) return;
+    std::uint64_t c[num_hw_events];
+    hw_->read(c);
+    for (int k=0; k<num_hw_events; ++k) {
+      if (active_ >= 0) hw_counts_[active_][k] += c[k]-hw_mark_[k];
+      hw_mark_[k] = c[k];
+    }
+  }
+  void write_hw_json(std::ostream& os) const;
+  // for the tick rate
+  std::uint64_t start_ticks_;
+  std::chrono::steady_clock::time_point start_time_;
+  double ticks_per_second(void) const;
+};
+
+class ScopedPhase
+{
+public:
+  ScopedPhase(Profile& profile, const phase& p)
+    : profile_(profile), parent_(profile.enter(p)) {}
+  ~ScopedPhase() { profile_.leave(parent_); }
+private:
+  Profile& profile_;
+  int parent_;
+};
+
+const char* phase_name(const phase& p);
+const char* move_name(const move& m);
+
+} // end namespace instrument
+
+#define INSTRUMENT_CONCAT_(a,b) a##b
+#define INSTRUMENT_CONCAT(a,b) INSTRUMENT_CONCAT_(a,b)
+#ifdef VMC_INSTRUMENT
+#define INSTRUMENT_PHASE(profile, ph) instrument::ScopedPhase \
+  INSTRUMENT_CONCAT(instrument_phase_,__LINE__)(profile, instrument::phase::ph)
+#define INSTRUMENT_COUNT(profile, mv, ev) \
+  (profile).count(instrument::move::mv, instrument::event::ev)
+#else
+#define INSTRUMENT_PHASE(profile, ph)
+#define INSTRUMENT_COUNT(profile, mv, ev)
+#endif
+
+#endif
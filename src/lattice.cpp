@@ -6,19 +6,87 @@
 *----------------------------------------------------------------------------*/
 // File: lattice.cpp
 
+#include <algorithm>
+#include <cstdint>
 #include <Eigen/Dense>
 #include "constants.h"
 #include "lattice.h"
 
-void Lattice::construct(const lattice_id& id, const lattice_size& size)
+void Lattice::construct(const lattice_id& id, const lattice_size& size, 
+	const site_order& order)
+{
+	construct(id, size, default_bc(id), order);
+}
+
+lattice_bc Lattice::default_bc(const lattice_id& id)
+{
+	switch (id) {
+		case lattice_id::SQUARE: 
+      return lattice_bc(bc_t::PERIODIC, bc_t::ANTIPERIODIC, bc_t::OPEN);
+		default: 
+      return lattice_bc(bc_t::PERIODIC, bc_t::PERIODIC, bc_t::PERIODIC);
+	}
+}
+
+void Lattice::construct(const lattice_id& id, const lattice_size& size, 
+	const lattice_bc& bc, const site_order& order)
 {
 	id_ = id;
 	size_ = size;
-	switch (id_) {
+	order_ = order;
+	bc_ = bc;
+	unit_cell cell;
+	get_unit_cell(id_, cell);
+	lattice_dim_ = cell.dim;
+	if ((lattice_dim_<2 && size_.L2()>1) || (lattice_dim_<3 && size_.L3()>1)) 
+		throw std::invalid_argument("Lattice::construct: size exceeds the lattice dimension\n");
+	build(cell);
+	construct_symmetry(cell);
+}
+
+void Lattice::get_unit_cell(const lattice_id& id, unit_cell& cell) const
+{
+	// Bravais vectors, basis sites & the bonds of a unit cell 
+	cell.a1 = Vector3d(0,0,0);
+	cell.a2 = Vector3d(0,0,0);
+	cell.a3 = Vector3d(0,0,0);
+	cell.basis.clear();
+	cell.bonds.clear();
+	switch (id) {
+		case lattice_id::CHAIN: 
+			cell.dim = 1;
+			cell.a1 = Vector3d(1,0,0);
+			cell.basis.push_back(Vector3d(0,0,0));
+			cell.bonds.push_back({0, 0, Vector3i(1,0,0)});
+			break;
 		case lattice_id::SQUARE: 
-			lattice_dim_ = 2;
-      bc_ = {bc_t::PERIODIC, bc_t::ANTIPERIODIC, bc_t::OPEN};
-			construct_square(size);
+			cell.dim = 2;
+			cell.a1 = Vector3d(1,0,0);
+			cell.a2 = Vector3d(0,1,0);
+			cell.basis.push_back(Vector3d(0,0,0));
+			cell.bonds.push_back({0, 0, Vector3i(1,0,0)});
+			cell.bonds.push_back({0, 0, Vector3i(0,1,0)});
+			break;
+		case lattice_id::HONEYCOMB: 
+			// A & B sublattices, each A site bonds to the B sites of three cells
+			cell.dim = 2;
+			cell.a1 = Vector3d(1,0,0);
+			cell.a2 = Vector3d(0.5,0.5*std::sqrt(3.0),0);
+			cell.basis.push_back(Vector3d(0,0,0));
+			cell.basis.push_back((cell.a1+cell.a2)/3.0);
+			cell.bonds.push_back({0, 1, Vector3i(0,0,0)});
+			cell.bonds.push_back({0, 1, Vector3i(-1,0,0)});
+			cell.bonds.push_back({0, 1, Vector3i(0,-1,0)});
+			break;
+		case lattice_id::SIMPLECUBIC: 
+			cell.dim = 3;
+			cell.a1 = Vector3d(1,0,0);
+			cell.a2 = Vector3d(0,1,0);
+			cell.a3 = Vector3d(0,0,1);
+			cell.basis.push_back(Vector3d(0,0,0));
+			cell.bonds.push_back({0, 0, Vector3i(1,0,0)});
+			cell.bonds.push_back({0, 0, Vector3i(0,1,0)});
+			cell.bonds.push_back({0, 0, Vector3i(0,0,1)});
 			break;
 		default: 
 			throw std::range_error("This lattice not implemented\n");
@@ -26,103 +94,337 @@ void Lattice::construct(const lattice_id& id, const lattice_size& size)
 	}
 }
 
-void Lattice::construct_square(const lattice_size& size)
+void Lattice::build(const unit_cell& cell)
 {
-	num_basis_sites_ = 1;
-	num_sites_ = num_basis_sites_ * size_.L1() * size_.L2();
-	a1_ = Vector3d(1,0,0);
-	a2_ = Vector3d(0,1,0);
-	a3_ = Vector3d(0,0,0);
-	construct_kpoints();
-
-  //------- Nearest Neighbout Table
-  // Numbering scheme for the SQUARE lattice:
-  /*
+  /* Generic builder. Sites are numbered cell by cell (in the 'site_order'),
+    basis sites within a cell; bonds cell by cell in the order of 'cell.bonds'.
+    Numbering scheme for the SQUARE lattice (ROW_MAJOR):
   *   12   13   14   15      
   *    8    9   10   11      
   *    4    5    6    7     
   *    0    1    2    3    
   *-----------------------------------------*/
-  num_neighbs_ = 4; 
-  nn_table_.resize(num_sites_);
-  for (int i=0; i<num_sites_; ++i) nn_table_[i].resize(num_neighbs_);
-
-  int L1 = size_.L1();
-  int L2 = size_.L2();
-  enum nn_dir {right_nn, top_nn, left_nn, bottom_nn};
-
-  // Right NNs
-  for (int i=0; i<num_sites_; ++i) nn_table_[i][right_nn] = i+1;
-  // Top NNs
-  for (int i=0; i<num_sites_; ++i) nn_table_[i][top_nn] = i+L1;
-  // Left NNs
-  for (int i=0; i<num_sites_; ++i) nn_table_[i][left_nn] = i-1;
-  // Bottom NNs
-  for (int i=0; i<num_sites_; ++i) nn_table_[i][bottom_nn] = i-L1;
-
-  // Take care of the boundary points
-  int m1 = L1-1; 
-  int m2 = L1 * (L2-1);
-
-  // bottom line
-  for (int i=0; i<L1; ++i) nn_table_[i][bottom_nn] = i + m2;
-  // right line
-  for (int i=m1; i<num_sites_; i += L1) nn_table_[i][right_nn] = i - m1;
-  // top line
-  for (int i=m2; i<num_sites_; ++i) nn_table_[i][top_nn] = i - m2;
-  // left line
-  for (int i=0; i<num_sites_; i += L1) nn_table_[i][left_nn] = i + m1;
-  // print
-  /*
-  for (int i=0; i<num_sites_; ++i) {
-    std::cout << "nn_table[i][nn] = " << i << " " << nn_table_[i][0] 
-      << " " << nn_table_[i][1] << " "
-      << nn_table_[i][2] << " " << nn_table_[i][3] << std::endl;
-  }*/
+	num_basis_sites_ = cell.basis.size();
+	a1_ = cell.a1;
+	a2_ = cell.a2;
+	a3_ = cell.a3;
+	const int L[3] = {size_.L1(), size_.L2(), size_.L3()};
+	const bc_t bc[3] = {bc_.L1_bc(), bc_.L2_bc(), bc_.L3_bc()};
+	int num_cells = L[0]*L[1]*L[2];
+	num_sites_ = num_basis_sites_ * num_cells;
+	twist_ = Vector3d(0,0,0);
+	construct_kpoints();
 
-  // Position Coordinates
-  /*Vector3i n = {0,0,0};
-  rpoints_.clear();
-  for (int i=0; i<num_sites_; ++i) {
-    Vector3d R = n(0) * a1_ + n(1) * a2_ + n(2) * a3_;
-    rpoints_.push_back(R);
-    n = get_next_bravindex(n);
-  }*/
-  // check
-  /*for (int i=0; i<num_sites_; ++i) {
-    std::cout << i << ": " << rpoints_[i].transpose() << "\n";
-  }*/
+  // cells in the site order & their position in it
+  std::vector<int> cell_order;
+  get_cell_order(cell_order);
+  std::vector<int> cell_rank(num_cells);
+  for (int r=0; r<num_cells; ++r) cell_rank[cell_order[r]] = r;
 
   // Sites in the lattice
   sites_.clear();
-  Vector3i n = {0,0,0};
+  sites_.reserve(num_sites_);
+  canonical_site_.resize(num_sites_);
+  site_index_.resize(num_sites_);
+  for (int r=0; r<num_cells; ++r) {
+    int c = cell_order[r];
+    Vector3d R = (c%L[0])*a1_ + ((c/L[0])%L[1])*a2_ + (c/(L[0]*L[1]))*a3_;
+    for (int b=0; b<num_basis_sites_; ++b) {
+      int i = r*num_basis_sites_+b;
+      sites_.push_back(Site(i, b, R, R+cell.basis[b]));
+      canonical_site_[i] = c*num_basis_sites_+b;
+      site_index_[c*num_basis_sites_+b] = i;
+    }
+  }
+
+  // Bonds: wrapped around the boundaries, with phase -1 for every crossing 
+  // of an ANTIPERIODIC one, and dropped across an OPEN one
+  int nb = cell.bonds.size();
+  bond_src_.clear();
+  bond_tgt_.clear();
+  bond_phase_.clear();
+  bond_vector_.clear();
+  bond_wraps_.clear();
+  bond_src_.reserve(num_cells*nb);
+  bond_tgt_.reserve(num_cells*nb);
+  bond_phase_.reserve(num_cells*nb);
+  bond_vector_.reserve(num_cells*nb);
+  bond_wraps_.reserve(num_cells*nb);
+  std::vector<int> bond_type; // index in 'cell.bonds'
+  bond_type.reserve(num_cells*nb);
+  for (int r=0; r<num_cells; ++r) {
+    int c = cell_order[r];
+    const int n[3] = {c%L[0], (c/L[0])%L[1], c/(L[0]*L[1])};
+    for (int t=0; t<nb; ++t) {
+      const cell_bond& cb = cell.bonds[t];
+      int m[3];
+      int phase = 1;
+      bool dropped = false;
+      Vector3i bond_wraps(0,0,0);
+      for (int d=0; d<3; ++d) {
+        m[d] = n[d] + cb.shift(d);
+        int wraps = (m[d]>=0) ? m[d]/L[d] : -((L[d]-1-m[d])/L[d]);
+        m[d] -= wraps*L[d];
+        bond_wraps(d) = wraps;
+        if (wraps == 0) continue;
+        if (bc[d]==bc_t::OPEN) dropped = true;
+        else if (bc[d]==bc_t::ANTIPERIODIC && wraps%2 != 0) phase = -phase;
+      }
+      if (dropped) continue;
+      bond_src_.push_back(r*num_basis_sites_ + cb.src);
+      bond_tgt_.push_back(cell_rank[m[0] + L[0]*(m[1] + L[1]*m[2])]*num_basis_sites_ + cb.tgt);
+      bond_phase_.push_back(phase);
+      bond_wraps_.push_back(bond_wraps);
+      bond_vector_.push_back(cb.shift(0)*a1_ + cb.shift(1)*a2_ + cb.shift(2)*a3_ 
+        + cell.basis[cb.tgt] - cell.basis[cb.src]);
+      bond_type.push_back(t);
+    }
+  }
+  num_bonds_ = bond_src_.size();
+  bond_twist_.assign(num_bonds_, 1.0);
+
+  //------- Nearest Neighbour Table (CSR)
+  // of a site: the targets of its bonds, then the sources of the bonds 
+  // ending on it (for SQUARE: right, top, left, bottom)
+  nn_offsets_.assign(num_sites_+1, 0);
+  for (int i=0; i<num_bonds_; ++i) {
+    nn_offsets_[bond_src_[i]+1]++;
+    nn_offsets_[bond_tgt_[i]+1]++;
+  }
+  num_neighbs_ = 0;
   for (int i=0; i<num_sites_; ++i) {
-    Vector3d R = n(0)*a1_ + n(1)*a2_ + n(2)*a3_;
-    sites_.push_back(Site(i,0,R));
-    n = get_next_bravindex(n);
+    num_neighbs_ = std::max(num_neighbs_, nn_offsets_[i+1]);
+    nn_offsets_[i+1] += nn_offsets_[i];
+  }
+  nn_sites_.resize(2*num_bonds_);
+  std::vector<int> pos(nn_offsets_.begin(), nn_offsets_.end()-1);
+  for (int i=0; i<num_bonds_; ++i) nn_sites_[pos[bond_src_[i]]++] = bond_tgt_[i];
+  for (int t=0; t<nb; ++t) {
+    for (int i=0; i<num_bonds_; ++i) {
+      if (bond_type[i] == t) nn_sites_[pos[bond_tgt_[i]]++] = bond_src_[i];
+    }
+  }
+}
+
+void Lattice::get_cell_order(std::vector<int>& cell_order) const
+{
+  // row-major index of the cells, sorted by their position along the curve
+  const int L[3] = {size_.L1(), size_.L2(), size_.L3()};
+  int num_cells = L[0]*L[1]*L[2];
+  cell_order.resize(num_cells);
+  for (int c=0; c<num_cells; ++c) cell_order[c] = c;
+  if (order_==site_order::ROW_MAJOR || lattice_dim_<2) return;
+  int dim = lattice_dim_;
+  int bits = 1;
+  while ((1<<bits) < std::max(L[0], std::max(L[1], L[2]))) ++bits;
+  std::vector<std::uint64_t> key(num_cells);
+  for (int c=0; c<num_cells; ++c) {
+    unsigned x[3] = {unsigned(c%L[0]), unsigned((c/L[0])%L[1]), unsigned(c/(L[0]*L[1]))};
+    if (order_ == site_order::HILBERT) {
+      // Skilling's transform of the axes into the 'transposed' Hilbert index
+      unsigned M = 1u << (bits-1);
+      for (unsigned Q=M; Q>1; Q>>=1) {
+        unsigned P = Q-1;
+        for (int i=0; i<dim; ++i) {
+          if (x[i] & Q) x[0] ^= P;
+          else {
+            unsigned t = (x[0]^x[i]) & P;
+            x[0] ^= t;
+            x[i] ^= t;
+          }
+        }
+      }
+      for (int i=1; i<dim; ++i) x[i] ^= x[i-1];
+      unsigned t = 0;
+      for (unsigned Q=M; Q>1; Q>>=1) if (x[dim-1] & Q) t ^= Q-1;
+      for (int i=0; i<dim; ++i) x[i] ^= t;
+    }
+    // interleave the bits (for MORTON, of the coordinates themselves)
+    std::uint64_t k = 0;
+    for (int b=bits-1; b>=0; --b) {
+      for (int i=0; i<dim; ++i) k = (k<<1) | ((x[i]>>b) & 1u);
+    }
+    key[c] = k;
   }
+  std::sort(cell_order.begin(), cell_order.end(), 
+    [&key](const int& a, const int& b) { return key[a] < key[b]; });
+}
 
-  // Bonds in the lattice
-  bonds_.clear();
-  int id = 0;
-  int nn, phase;
-  Vector3d R;
+int Lattice::translate(const int& site, const Vector3i& shift) const
+{
+  const int L[3] = {size_.L1(), size_.L2(), size_.L3()};
+  const bc_t bc[3] = {bc_.L1_bc(), bc_.L2_bc(), bc_.L3_bc()};
+  int m[3];
+  for (int d=0; d<3; ++d) {
+    m[d] = site_cell_[3*site+d] + shift(d);
+    if (m[d]>=0 && m[d]<L[d]) continue;
+    if (bc[d] == bc_t::OPEN) return -1;
+    m[d] = ((m[d]%L[d])+L[d])%L[d];
+  }
+  int c = m[0] + L[0]*(m[1] + L[1]*m[2]);
+  return site_index_[c*num_basis_sites_ + sites_[site].basis_id()];
+}
+
+int Lattice::pair_key(const int& i, const int& j) const
+{
+  // per axis: displacement mod L, or both positions along an OPEN axis
+  const int L[3] = {size_.L1(), size_.L2(), size_.L3()};
+  int key = 0;
+  for (int d=2; d>=0; --d) {
+    int ni = site_cell_[3*i+d];
+    int nj = site_cell_[3*j+d];
+    int k = (key_size_[d]==L[d]) ? (nj-ni+L[d])%L[d] : ni*L[d]+nj;
+    key = key*key_size_[d] + k;
+  }
+  return (key*num_basis_sites_ + sites_[i].basis_id())*num_basis_sites_ + sites_[j].basis_id();
+}
+
+void Lattice::construct_symmetry(const unit_cell& cell)
+{
+  const int L[3] = {size_.L1(), size_.L2(), size_.L3()};
+  const bc_t bc[3] = {bc_.L1_bc(), bc_.L2_bc(), bc_.L3_bc()};
+  int nb = num_basis_sites_;
+  int dim = lattice_dim_;
+  site_cell_.resize(3*num_sites_);
   for (int i=0; i<num_sites_; ++i) {
-    nn = nn_table_[i][right_nn];
-    phase = 1;
-    if (bc_.L1_bc()==bc_t::ANTIPERIODIC && nn<i) phase = -1;
-    R = sites_[nn].cell_coord()-sites_[i].cell_coord();
-    bonds_.push_back(Bond(id,i,nn,phase,R));
-    id++;
-
-    nn = nn_table_[i][top_nn];
-    phase = 1;
-    if (bc_.L2_bc()==bc_t::ANTIPERIODIC && nn<i) phase = -1;
-    R = sites_[nn].cell_coord()-sites_[i].cell_coord();
-    bonds_.push_back(Bond(id,i,nn,phase,R));
-    id++;
-  }
-  num_bonds_ = bonds_.size();
+    int c = canonical_site_[i]/nb;
+    site_cell_[3*i] = c%L[0];
+    site_cell_[3*i+1] = (c/L[0])%L[1];
+    site_cell_[3*i+2] = c/(L[0]*L[1]);
+  }
+  bool open[3];
+  for (int d=0; d<3; ++d) open[d] = (bc[d]==bc_t::OPEN && L[d]>1);
+
+  //------- point group: integer matrices M acting on the Bravais indices,
+  // with entries -1,0,1, that preserve the metric of the cell, map the 
+  // basis sites onto basis sites (up to a cell shift) and the periodic 
+  // torus onto itself 
+  Eigen::Matrix3d A;
+  A.col(0) = cell.a1; A.col(1) = cell.a2; A.col(2) = cell.a3;
+  Eigen::MatrixXd Ad = A.leftCols(dim);
+  Eigen::MatrixXd G = Ad.transpose()*Ad;
+  // fractional coordinates of the basis sites
+  std::vector<Eigen::VectorXd> frac(nb);
+  for (int b=0; b<nb; ++b) frac[b] = G.ldlt().solve(Ad.transpose()*cell.basis[b]);
+  struct point_op { Eigen::Matrix3i M; std::vector<int> perm; std::vector<Vector3i> shift; };
+  std::vector<point_op> ops;
+  int num_candidates = 1;
+  for (int k=0; k<dim*dim; ++k) num_candidates *= 3;
+  for (int code=0; code<num_candidates; ++code) {
+    Eigen::Matrix3i M = Eigen::Matrix3i::Identity();
+    int x = code;
+    for (int k=0; k<dim*dim; ++k) { M(k/dim, k%dim) = x%3-1; x /= 3; }
+    if (std::abs(M.cast<double>().determinant()) != 1.0) continue;
+    Eigen::MatrixXd Md = M.topLeftCorner(dim,dim).cast<double>();
+    if ((Md.transpose()*G*Md - G).cwiseAbs().maxCoeff() > 1.0E-8) continue;
+    bool ok = true;
+    for (int r=0; r<dim && ok; ++r) {
+      for (int c=0; c<dim && ok; ++c) {
+        if (M(r,c) == 0) continue;
+        // equal sizes & boundaries of the mixed axes, nothing moves along an OPEN axis
+        if (L[r]!=L[c] || bc[r]!=bc[c]) ok = false;
+        if ((open[r] || open[c]) && (r!=c || M(r,c)!=1)) ok = false;
+      }
+    }
+    if (!ok) continue;
+    point_op op;
+    op.M = M;
+    for (int b=0; b<nb && ok; ++b) {
+      Eigen::VectorXd f = Md*frac[b];
+      int found = -1;
+      Vector3i shift(0,0,0);
+      for (int b2=0; b2<nb && found<0; ++b2) {
+        Eigen::VectorXd df = f - frac[b2];
+        Eigen::VectorXd rdf = df.array().round().matrix();
+        if ((df-rdf).cwiseAbs().maxCoeff() < 1.0E-8) {
+          found = b2;
+          for (int d=0; d<dim; ++d) shift(d) = static_cast<int>(rdf(d));
+        }
+      }
+      if (found < 0) ok = false;
+      op.perm.push_back(found);
+      op.shift.push_back(shift);
+    }
+    if (ok && std::find(op.perm.begin(),op.perm.end(),-1)==op.perm.end()) ops.push_back(op);
+  }
+  // site permutations
+  num_symm_ops_ = ops.size();
+  symm_perm_.resize(num_symm_ops_*num_sites_);
+  for (int g=0; g<num_symm_ops_; ++g) {
+    for (int i=0; i<num_sites_; ++i) {
+      Vector3i n(site_cell_[3*i], site_cell_[3*i+1], site_cell_[3*i+2]);
+      int b = sites_[i].basis_id();
+      Vector3i m = ops[g].M*n + ops[g].shift[b];
+      for (int d=0; d<3; ++d) m(d) = ((m(d)%L[d])+L[d])%L[d];
+      int c = m(0) + L[0]*(m(1) + L[1]*m(2));
+      symm_perm_[g*num_sites_+i] = site_index_[c*nb + ops[g].perm[b]];
+    }
+  }
+
+  //------- classes of equivalent site pairs 
+  int num_keys = nb*nb;
+  for (int d=0; d<3; ++d) {
+    key_size_[d] = open[d] ? L[d]*L[d] : L[d];
+    num_keys *= key_size_[d];
+  }
+  disp_class_.assign(num_keys, -1);
+  class_mult_.clear();
+  class_vector_.clear();
+  num_disp_classes_ = 0;
+  for (int key=0; key<num_keys; ++key) {
+    if (disp_class_[key] >= 0) continue;
+    // a representative pair (i,j) of this key
+    int bj = key%nb;
+    int bi = (key/nb)%nb;
+    int k = key/(nb*nb);
+    int ni[3], nj[3];
+    for (int d=0; d<3; ++d) {
+      int kd = k%key_size_[d];
+      k /= key_size_[d];
+      if (open[d]) { ni[d] = kd/L[d]; nj[d] = kd%L[d]; }
+      else { ni[d] = 0; nj[d] = kd; }
+    }
+    int i = site_index_[(ni[0]+L[0]*(ni[1]+L[1]*ni[2]))*nb + bi];
+    int j = site_index_[(nj[0]+L[0]*(nj[1]+L[1]*nj[2]))*nb + bj];
+    // orbit under the point group (translations are in the key already)
+    int c = num_disp_classes_++;
+    int mult = 0;
+    for (int g=0; g<num_symm_ops_; ++g) {
+      int key2 = pair_key(symm_map(g,i), symm_map(g,j));
+      if (disp_class_[key2] >= 0) continue;
+      disp_class_[key2] = c;
+      // number of pairs with this key
+      int count = 1;
+      for (int d=0; d<3; ++d) if (!open[d]) count *= L[d];
+      mult += count;
+    }
+    class_mult_.push_back(mult);
+    // shortest image of the displacement
+    Vector3d R = cell.basis[bj] - cell.basis[bi];
+    const Vector3d* a[3] = {&a1_, &a2_, &a3_};
+    for (int d=0; d<3; ++d) {
+      int dn = nj[d]-ni[d];
+      if (!open[d] && dn > L[d]/2) dn -= L[d];
+      R += dn * (*a[d]);
+    }
+    class_vector_.push_back(R);
+  }
+}
+
+void Lattice::set_twist(const Vector3d& twist)
+{
+  const int L[3] = {size_.L1(), size_.L2(), size_.L3()};
+  const bc_t bc[3] = {bc_.L1_bc(), bc_.L2_bc(), bc_.L3_bc()};
+  for (int d=0; d<3; ++d) {
+    if (twist(d)!=0.0 && (bc[d]==bc_t::OPEN || L[d]==1))
+      throw std::invalid_argument("Lattice::set_twist: twist along an open (or unit) axis\n");
+  }
+  twist_ = twist;
+  bond_twist_.resize(num_bonds_);
+  for (int i=0; i<num_bonds_; ++i) {
+    bond_twist_[i] = std::polar(1.0, twist_.dot(bond_wraps_[i].cast<double>()));
+  }
+  construct_kpoints();
 }
 
 void Lattice::construct_kpoints(void)
@@ -163,6 +465,10 @@ void Lattice::construct_kpoints(void)
   if (bc_.L3_bc()==bc_t::ANTIPERIODIC) {
     antipb_shift(2) = 0.5/size_.L3();
   }
+  // boundary twist
+  antipb_shift(0) += twist_(0)/(TWO_PI*size_.L1());
+  antipb_shift(1) += twist_(1)/(TWO_PI*size_.L2());
+  antipb_shift(2) += twist_(2)/(TWO_PI*size_.L3());
 
   // kpoints
   num_kpoints_ = num_sites_/num_basis_sites_;
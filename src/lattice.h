@@ -11,13 +11,22 @@
 #include <iostream>
 #include <stdexcept>
 #include <vector>
+#include <complex>
 #include "matrix.h"
 
+/* CHAIN, HONEYCOMB & SIMPLECUBIC are geometry only for now: no wavefunction
+*  is implemented on them (see Wavefunction::supports), so they can't be run. */
 enum class lattice_id {
   CHAIN, SQUARE, HONEYCOMB, SIMPLECUBIC
 };
 
 enum class bc_t { PERIODIC, ANTIPERIODIC, OPEN };
+
+/* Numbering of the unit cells. ROW_MAJOR is the canonical order (first index
+*  fastest); MORTON & HILBERT follow a space filling curve, so that sites close
+*  in space are close in memory. Results indexed by site are mapped back with 
+*  'canonical_site()'. */
+enum class site_order { ROW_MAJOR, MORTON, HILBERT };
 class lattice_bc
 {
 public:
@@ -65,20 +74,44 @@ private:
 	int L3_;
 };
 
+// bond from basis site 'src' in cell 'n' to basis site 'tgt' in cell 'n+shift' 
+// (cells labelled by their Bravais indices)
+struct cell_bond
+{
+	int src;
+	int tgt;
+	Vector3i shift;
+};
+
+// input of the generic lattice builder
+struct unit_cell
+{
+	int dim;
+	Vector3d a1;
+	Vector3d a2;
+	Vector3d a3;
+	std::vector<Vector3d> basis; // position of the basis sites in the cell
+	std::vector<cell_bond> bonds;
+};
+
 class Site
 {
 public:
 	Site() {}
 	Site(const int& id, const int& basis_id, const Vector3d& cell_coord)
-		: id_{id}, basis_id_{basis_id}, cell_coord_{cell_coord} {}
+		: id_{id}, basis_id_{basis_id}, cell_coord_{cell_coord}, coord_{cell_coord} {}
+	Site(const int& id, const int& basis_id, const Vector3d& cell_coord, const Vector3d& coord)
+		: id_{id}, basis_id_{basis_id}, cell_coord_{cell_coord}, coord_{coord} {}
 	~Site() {}
 	const int& id(void) const { return id_; }
 	const int& basis_id(void) const { return basis_id_; }
 	const Vector3d& cell_coord(void) const { return cell_coord_; }
+	const Vector3d& coord(void) const { return coord_; }
 private:
 	int id_;
 	int basis_id_;
 	Vector3d cell_coord_;
+	Vector3d coord_;
 };
 
 class Bond
@@ -101,12 +134,39 @@ private:
 	Vector3d vector_{0,0,0};
 };
 
+// neighbours of a site, a view into the CSR arrays of Lattice
+class site_range
+{
+public:
+	site_range(const int* begin, const int* end) : begin_{begin}, end_{end} {}
+	const int* begin(void) const { return begin_; }
+	const int* end(void) const { return end_; }
+	int size(void) const { return end_-begin_; }
+	const int& operator[](const int& i) const { return begin_[i]; }
+private:
+	const int* begin_;
+	const int* end_;
+};
+
+/* Bonds and neighbours are stored as flat arrays ('structure of arrays'): 
+*  bond 'i' connects bond_src()[i] -> bond_tgt()[i] with bond_phase()[i], and
+*  the neighbours of site 'i' are nn_sites[nn_offsets[i]..nn_offsets[i+1]) (CSR).
+*  'bond(i)' assembles a Bond object and 'site_nn(i)' gives the neighbours of
+*  a site as a range, for convenience outside hot loops (API only, nothing 
+*  in the tree uses them yet).
+*/
 class Lattice
 {
 public:
 	Lattice() : id_{lattice_id::CHAIN} { num_sites_=1; }
-	Lattice(const lattice_id& id, const lattice_size& size) { construct(id, size); }
-	void construct(const lattice_id& id, const lattice_size& size);
+	Lattice(const lattice_id& id, const lattice_size& size, 
+		const site_order& order=site_order::ROW_MAJOR) { construct(id, size, order); }
+	void construct(const lattice_id& id, const lattice_size& size, 
+		const site_order& order=site_order::ROW_MAJOR);
+	void construct(const lattice_id& id, const lattice_size& size, const lattice_bc& bc,
+		const site_order& order=site_order::ROW_MAJOR);
+	// SQUARE: periodic along x, antiperiodic along y; others periodic
+	static lattice_bc default_bc(const lattice_id& id);
 	~Lattice() {}
 	void set_bc(const bc_t& bc1, const bc_t& bc2, const bc_t& bc3) 
 		{ bc_.set(bc1, bc2, bc3); }
@@ -122,16 +182,51 @@ public:
 	const int& num_basis_sites(void) const { return num_basis_sites_; }
 	const int& num_kpoints(void) const { return num_kpoints_; }
 	const int& num_neighbs(void) const { return num_neighbs_; }
+	const site_order& order(void) const { return order_; }
+	// site index in the ROW_MAJOR numbering & back
+	const int& canonical_site(const int& i) const { return canonical_site_[i]; }
+	const int& site_index(const int& canonical) const { return site_index_[canonical]; }
+	const std::vector<int>& canonical_sites(void) const { return canonical_site_; }
 	const Site& site(const int& i) const { return sites_[i]; }
-	const Bond& bond(const int& i) const { return bonds_[i]; }
-	const std::vector<int>& site_nn(const int& site) const { return nn_table_[site]; }
+	Bond bond(const int& i) const 
+		{ return Bond(i, bond_src_[i], bond_tgt_[i], bond_phase_[i], bond_vector_[i]); }
+	const std::vector<int>& bond_src(void) const { return bond_src_; }
+	const std::vector<int>& bond_tgt(void) const { return bond_tgt_; }
+	const std::vector<int>& bond_phase(void) const { return bond_phase_; }
+	/* Boundary twist: angles (per axis) added to the phase picked up by a
+	*  particle going around the lattice, on top of the 'bc'. An UP spin 
+	*  hopping src->tgt of bond 'i' gets the factor 'bond_twist()[i]' (the 
+	*  conjugate for tgt->src), a DN spin sees the opposite twist. The 
+	*  k-points are shifted accordingly. */
+	void set_twist(const Vector3d& twist);
+	const Vector3d& twist(void) const { return twist_; }
+	bool has_twist(void) const { return !twist_.isZero(0.0); }
+	const std::vector<std::complex<double> >& bond_twist(void) const { return bond_twist_; }
+	site_range site_nn(const int& site) const 
+		{ return site_range(nn_sites_.data()+nn_offsets_[site], nn_sites_.data()+nn_offsets_[site+1]); }
+	const std::vector<int>& nn_offsets(void) const { return nn_offsets_; }
+	const std::vector<int>& nn_sites(void) const { return nn_sites_; }
 	const Vector3d& kpoint(const int& i) const { return kpoints_[i]; }
 	const std::vector<Vector3d>& kpoints(void) { return kpoints_; }
 	//const Vector3d& site_coord(const int& i) const { return rpoints_[i]; }
+	// symmetries: translations by whole cells, and the point group operations
+	// (about the origin site) compatible with the lattice sizes and boundaries
+	int translate(const int& site, const Vector3i& shift) const; // -1 if outside (OPEN)
+	const int& num_symm_ops(void) const { return num_symm_ops_; }
+	const int& symm_map(const int& op, const int& site) const 
+		{ return symm_perm_[op*num_sites_+site]; }
+	// classes of symmetry equivalent site pairs (i,j); along a non-OPEN axis
+	// a pair enters by its displacement only (translation invariance)
+	const int& num_disp_classes(void) const { return num_disp_classes_; }
+	const int& disp_class(const int& i, const int& j) const 
+		{ return disp_class_[pair_key(i,j)]; }
+	const int& class_multiplicity(const int& c) const { return class_mult_[c]; }
+	const Vector3d& class_vector(const int& c) const { return class_vector_[c]; }
 private:
 	lattice_id id_;
 	lattice_size size_;
 	lattice_bc bc_;
+	site_order order_{site_order::ROW_MAJOR};
 	int lattice_dim_;
 	int num_basis_sites_; // number of sites per unit cell
 	int num_sites_; // total number of sites
@@ -145,11 +240,35 @@ private:
 	Vector3d b2_;
 	Vector3d b3_;
 	std::vector<Site> sites_;
-	std::vector<Bond> bonds_;
+	// bonds (SoA)
+	std::vector<int> bond_src_;
+	std::vector<int> bond_tgt_;
+	std::vector<int> bond_phase_;
+	std::vector<Vector3d> bond_vector_;
+	std::vector<Vector3i> bond_wraps_; // boundary crossings (per axis)
+	Vector3d twist_{0,0,0};
+	std::vector<std::complex<double> > bond_twist_;
 	std::vector<Vector3d> kpoints_;
 	//std::vector<Vector3d> rpoints_; // position coordinates
-	std::vector<std::vector<int> > nn_table_;
-	void construct_square(const lattice_size& size);
+	std::vector<int> canonical_site_;
+	std::vector<int> site_index_;
+	// neighbour table (CSR)
+	std::vector<int> nn_offsets_;
+	std::vector<int> nn_sites_;
+	// symmetry tables
+	std::vector<int> site_cell_; // Bravais indices of the sites (3 per site)
+	int num_symm_ops_{1};
+	std::vector<int> symm_perm_;
+	int key_size_[3]; 
+	std::vector<int> disp_class_;
+	int num_disp_classes_{0};
+	std::vector<int> class_mult_;
+	std::vector<Vector3d> class_vector_;
+	int pair_key(const int& i, const int& j) const;
+	void construct_symmetry(const unit_cell& cell);
+	void get_unit_cell(const lattice_id& id, unit_cell& cell) const;
+	void build(const unit_cell& cell);
+	void get_cell_order(std::vector<int>& cell_order) const;
 	void construct_kpoints(void);
 	Vector3i get_next_bravindex(const Vector3i& current_index) const;
 };
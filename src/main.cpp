@@ -8,10 +8,21 @@
 #include <iostream>
 #include "vmc.h"
 
+// usage: a.out [input_file] [name=value ...]
+// (with any of sweep_sizes, sweep_dopings, sweep_vparams or sweep_seeds 
+// the input is a parameter sweep, see VMC::init)
 int main(int argc, const char *argv[])
 {
   VMC vmc;
 
-  vmc.init();
-  vmc.run_simulation();
+  try {
+    vmc.init(input::Parameters(argc, argv));
+    if (vmc.sweep_given()) vmc.run_sweep();
+    else vmc.run_simulation();
+  }
+  catch (const std::exception& e) {
+    std::cout << e.what() << "\n";
+    return 1;
+  }
+  return 0;
 }
@@ -13,5 +13,6 @@ using RealMatrix = Eigen::MatrixXd;
 using ComplexMatrix = Eigen::MatrixXcd;
 using ColVector = Eigen::VectorXcd;
 using RowVector = Eigen::RowVectorXcd;
+using ComplexMatrixMap = Eigen::Map<Eigen::MatrixXcd>;
 
 #endif
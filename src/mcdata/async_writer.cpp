@@ -0,0 +1,130 @@
+#include "./async_writer.h"
+#include <stdexcept>
+#include <algorithm>
+#include <unistd.h>
+
+namespace mcdata {
+
+AsyncWriter::AsyncWriter(const std::size_t& flush_bytes, const double& flush_interval)
+  : flush_bytes_(flush_bytes), flush_interval_(flush_interval)
+{
+}
+
+AsyncWriter::~AsyncWriter()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_one();
+  if (thread_.joinable()) thread_.join();
+  for (auto& f : files_) {
+    if (f.second.fs != nullptr) std::fclose(f.second.fs);
+  }
+}
+
+AsyncWriter& AsyncWriter::global(void)
+{
+  static AsyncWriter writer;
+  return writer;
+}
+
+void AsyncWriter::write(const std::string& fname, const std::string& text, 
+  const bool& truncate)
+{
+  bool wake;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    check_error();
+    file_t& file = files_[fname];
+    if (truncate) {
+      // whatever is pending goes away with the old content
+      pending_bytes_ -= file.pending.size();
+      file.pending.clear();
+      file.truncate = true;
+    }
+    file.pending += text;
+    pending_bytes_ += text.size();
+    wake = (pending_bytes_ >= flush_bytes_);
+    if (!thread_.joinable()) thread_ = std::thread(&AsyncWriter::run, this);
+  }
+  if (wake) wake_.notify_one();
+}
+
+void AsyncWriter::sync(void)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!thread_.joinable()) return;
+  std::uint64_t ticket = ++sync_requested_;
+  wake_.notify_one();
+  synced_.wait(lock, [&]{ return sync_done_>=ticket; });
+  check_error();
+}
+
+void AsyncWriter::check_error(void) const
+{
+  if (!error_.empty()) throw std::runtime_error("AsyncWriter: "+error_);
+}
+
+void AsyncWriter::run(void)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    wake_.wait_for(lock, flush_interval_, [&]{ 
+      return stop_ || pending_bytes_>=flush_bytes_ || sync_requested_>sync_done_; });
+    // take over the pending data
+    jobs_.clear();
+    for (auto& f : files_) {
+      file_t& file = f.second;
+      if (file.pending.empty() && !file.truncate) continue;
+      jobs_.push_back(job_t{&f.first, &file, std::string(), file.truncate});
+      jobs_.back().data.swap(file.pending);
+      file.truncate = false;
+    }
+    pending_bytes_ = 0;
+    std::uint64_t sync_ticket = sync_requested_;
+    bool stop = stop_;
+    // the file system calls are made without the lock
+    lock.unlock();
+    bool sync = (sync_ticket>sync_done_ || stop);
+    std::string error;
+    try { write_jobs(sync); }
+    catch (const std::exception& e) { error = e.what(); }
+    lock.lock();
+    if (!error.empty() && error_.empty()) error_ = error;
+    if (sync) {
+      sync_done_ = sync_ticket;
+      synced_.notify_all();
+    }
+    if (stop && pending_bytes_==0) break;
+  }
+}
+
+void AsyncWriter::write_jobs(const bool& sync)
+{
+  // 'fs' of the files is only touched here (writer thread)
+  for (auto& job : jobs_) {
+    file_t& file = *job.file;
+    if (job.truncate && file.fs != nullptr) {
+      std::fclose(file.fs);
+      file.fs = nullptr;
+    }
+    if (file.fs == nullptr) {
+      file.fs = std::fopen(job.fname->c_str(), job.truncate ? "w" : "a");
+      if (file.fs == nullptr) throw std::runtime_error("file open failed for '"+*job.fname+"'");
+      if (std::find(open_files_.begin(),open_files_.end(),&file) == open_files_.end())
+        open_files_.push_back(&file);
+    }
+    if (std::fwrite(job.data.data(), 1, job.data.size(), file.fs) != job.data.size())
+      throw std::runtime_error("write failed for '"+*job.fname+"'");
+    if (std::fflush(file.fs) != 0) throw std::runtime_error("write failed for '"+*job.fname+"'");
+  }
+  if (!sync) return;
+  for (auto file : open_files_) {
+    if (file->fs != nullptr && fsync(fileno(file->fs)) != 0) 
+      throw std::runtime_error("fsync failed");
+  }
+}
+
+
+} // end namespace mcdata
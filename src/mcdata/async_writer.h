@@ -0,0 +1,72 @@
+#ifndef ASYNC_WRITER_H
+#define ASYNC_WRITER_H
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+
+namespace mcdata {
+
+/*---------------------------------------------------------------------------
+* Buffered output to text files from a background thread. 'write' only 
+* appends the text to the pending data of the file; the writer thread writes
+* it out in large chunks once 'flush_bytes' are pending or 'flush_interval' 
+* has passed. File handles stay open until the writer is destroyed. 
+* 'sync' is the durability point: when it returns, everything written before
+* is on disk (fsync). A failed write is reported by the next 'write'/'sync'.
+*----------------------------------------------------------------------------*/
+class AsyncWriter
+{
+public:
+  AsyncWriter(const std::size_t& flush_bytes=(1<<20), const double& flush_interval=1.0);
+  ~AsyncWriter();
+  // shared by all observables
+  static AsyncWriter& global(void);
+  // 'truncate' discards the earlier content of the file
+  void write(const std::string& fname, const std::string& text, const bool& truncate=false);
+  void sync(void);
+private:
+  struct file_t
+  {
+    std::FILE* fs{nullptr};
+    std::string pending;
+    bool truncate{false};
+  };
+  struct job_t
+  {
+    const std::string* fname;
+    file_t* file;
+    std::string data;
+    bool truncate;
+  };
+  std::size_t flush_bytes_;
+  std::chrono::duration<double> flush_interval_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable synced_;
+  std::map<std::string, file_t> files_;
+  std::size_t pending_bytes_{0};
+  std::uint64_t sync_requested_{0};
+  std::uint64_t sync_done_{0};
+  bool stop_{false};
+  std::string error_;
+  // used by the writer thread only
+  std::vector<job_t> jobs_;
+  std::vector<file_t*> open_files_;
+  std::thread thread_;
+
+  void run(void);
+  void write_jobs(const bool& sync);
+  void check_error(void) const;
+};
+
+
+} // end namespace mcdata
+
+#endif
@@ -0,0 +1,133 @@
+#include "./autocorr.h"
+#include <cmath>
+#include <stdexcept>
+
+namespace mcdata {
+
+void AutoCorrelation::init(const unsigned& capacity, const double& window_c) 
+{
+  if (capacity < 16 || window_c <= 0.0) 
+    throw std::invalid_argument("AutoCorrelation::init: invalid input");
+  capacity_ = capacity;
+  window_c_ = window_c;
+  ring_.resize(capacity_);
+  // zero padded to >= 2*capacity, so the correlation is not circular 
+  unsigned fft_size = 1;
+  while (fft_size < 2*capacity_) fft_size *= 2;
+  fft_work_.resize(fft_size);
+  twiddle_.resize(fft_size/2);
+  const double two_pi = 8.0*std::atan(1.0);
+  for (unsigned k=0; k<fft_size/2; ++k) 
+    twiddle_[k] = std::polar(1.0, -two_pi*k/fft_size);
+  clear();
+}
+
+void AutoCorrelation::clear(void) 
+{
+  pos_ = 0;
+  num_samples_ = 0;
+  sum_ = 0.0;
+  sumsq_ = 0.0;
+  num_samples_last_ = 0;
+  tau_int_ = -1.0;
+  window_ = 0;
+  reliable_ = false;
+}
+
+void AutoCorrelation::add_sample(const double& sample)
+{
+  ring_[pos_] = sample;
+  if (++pos_ == capacity_) pos_ = 0;
+  ++num_samples_;
+  sum_ += sample;
+  sumsq_ += sample*sample;
+}
+
+double AutoCorrelation::mean(void) const
+{
+  return num_samples_>0 ? sum_/num_samples_ : 0.0;
+}
+
+double AutoCorrelation::effective_samples(void) const
+{
+  update();
+  if (tau_int_ <= 0.0) return 0.0;
+  return num_samples_/(2.0*tau_int_);
+}
+
+double AutoCorrelation::stddev(void) const
+{
+  update();
+  if (tau_int_ <= 0.0 || num_samples_ < 2) return -1.0;
+  double n = static_cast<double>(num_samples_);
+  double var = (sumsq_/n - (sum_/n)*(sum_/n))*n/(n-1.0);
+  return std::sqrt(std::max(var, 0.0)*2.0*tau_int_/n);
+}
+
+void AutoCorrelation::update(void) const
+{
+  if (num_samples_ == num_samples_last_) return;
+  num_samples_last_ = num_samples_;
+  tau_int_ = -1.0;
+  window_ = 0;
+  reliable_ = false;
+  unsigned n = std::min<std::uint64_t>(num_samples_, capacity_);
+  if (n < 16) return;
+  // samples in time order, minus their mean, zero padded
+  unsigned first = (num_samples_ > capacity_) ? pos_ : 0;
+  double mean = 0.0;
+  for (unsigned i=0; i<n; ++i) mean += ring_[(first+i)%capacity_];
+  mean /= n;
+  unsigned m = 1;
+  while (m < 2*n) m *= 2;
+  complex_t* x = fft_work_.data();
+  for (unsigned i=0; i<n; ++i) x[i] = ring_[(first+i)%capacity_]-mean;
+  for (unsigned i=n; i<m; ++i) x[i] = 0.0;
+  // power spectrum, transformed back gives the autocovariance 
+  fft(x, m);
+  for (unsigned i=0; i<m; ++i) x[i] = std::norm(x[i]);
+  fft(x, m);
+  double c0 = x[0].real();
+  if (c0 <= 0.0) return;
+  // automatic window
+  double tau = 0.5;
+  for (unsigned t=1; t<n; ++t) {
+    tau += x[t].real()/c0;
+    if (t >= window_c_*tau) {
+      tau_int_ = std::max(tau, 0.5);
+      window_ = t;
+      reliable_ = (n >= 50.0*tau_int_);
+      return;
+    }
+  }
+  // no window found within the data: estimate is a lower bound
+  tau_int_ = std::max(tau, 0.5);
+  window_ = n-1;
+}
+
+void AutoCorrelation::fft(complex_t* x, const unsigned& n) const
+{
+  // iterative radix-2, in place (n is a power of 2, n <= twice the twiddle table)
+  for (unsigned i=1, j=0; i<n; ++i) {
+    unsigned bit = n >> 1;
+    for (; j & bit; bit >>= 1) j ^= bit;
+    j ^= bit;
+    if (i < j) std::swap(x[i], x[j]);
+  }
+  unsigned stride_0 = 2*twiddle_.size();
+  for (unsigned len=2; len<=n; len*=2) {
+    unsigned half = len/2;
+    unsigned stride = stride_0/len;
+    for (unsigned i=0; i<n; i+=len) {
+      for (unsigned k=0; k<half; ++k) {
+        complex_t u = x[i+k];
+        complex_t v = x[i+k+half]*twiddle_[k*stride];
+        x[i+k] = u+v;
+        x[i+k+half] = u-v;
+      }
+    }
+  }
+}
+
+
+} // end namespace mcdata
@@ -0,0 +1,64 @@
+#ifndef AUTOCORR_H
+#define AUTOCORR_H
+
+#include <cstdint>
+#include <vector>
+#include <complex>
+
+namespace mcdata {
+
+/*---------------------------------------------------------------------------
+* Online integrated autocorrelation time of a scalar series. The last 
+* 'capacity' samples are kept in a ring; on request, their autocorrelation 
+* function rho(t) is computed with an FFT and 
+*   tau_int = 1/2 + sum_{t=1}^{W} rho(t),
+* with the window W chosen as the smallest W >= c*tau_int(W) (Sokal). 
+* The variance of the mean is then 2*tau_int*var/N (N_eff = N/(2 tau_int)).
+* Memory is fixed and nothing allocates after 'init'.
+*----------------------------------------------------------------------------*/
+class AutoCorrelation
+{
+public:
+  AutoCorrelation() {}
+  AutoCorrelation(const unsigned& capacity, const double& window_c=5.0) 
+    { init(capacity, window_c); }
+  ~AutoCorrelation() {}
+  void init(const unsigned& capacity, const double& window_c=5.0);
+  void clear(void);
+  void add_sample(const double& sample);
+  void operator<<(const double& sample) { add_sample(sample); }
+  const std::uint64_t& num_samples(void) const { return num_samples_; }
+  double mean(void) const;
+  // -1 if not enough samples
+  double tau_int(void) const { update(); return tau_int_; }
+  const unsigned& window(void) const { update(); return window_; }
+  // the window fits within the data and the ring holds >= 50 tau_int samples
+  bool reliable(void) const { update(); return reliable_; }
+  double effective_samples(void) const;
+  // error bar of the mean of all samples
+  double stddev(void) const;
+private:
+  using complex_t = std::complex<double>;
+  unsigned capacity_{0};
+  double window_c_{5.0};
+  std::vector<double> ring_;
+  unsigned pos_{0};
+  std::uint64_t num_samples_{0};
+  double sum_{0.0};
+  double sumsq_{0.0};
+  // analysis
+  mutable std::uint64_t num_samples_last_{0};
+  mutable double tau_int_{-1.0};
+  mutable unsigned window_{0};
+  mutable bool reliable_{false};
+  mutable std::vector<complex_t> fft_work_;
+  std::vector<complex_t> twiddle_;
+
+  void update(void) const;
+  void fft(complex_t* x, const unsigned& n) const;
+};
+
+
+} // end namespace mcdata
+
+#endif
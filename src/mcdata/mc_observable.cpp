@@ -75,48 +75,54 @@ void MC_Observable::print_heading(const std::string& header,
   if (!is_on()) return;
   if (heading_printed_) return;
   if (!replace_mode_) return;
-  if (!fs_.is_open()) open_file();
-  fs_ << header;
-  fs_ << "# Results: " << name() << "\n";
-  fs_ << "#" << std::string(72, '-') << "\n";
-  fs_ << "# ";
-  fs_ << std::left;
-  //fs_ << std::setw(14)<<xvar_name;
-  for (const auto& p : xvars) fs_ << std::setw(14)<<p.substr(0,14);
+  std::ostringstream os;
+  os << header;
+  os << "# Results: " << name() << "\n";
+  os << "#" << std::string(72, '-') << "\n";
+  os << "# ";
+  os << std::left;
+  //os << std::setw(14)<<xvar_name;
+  for (const auto& p : xvars) os << std::setw(14)<<p.substr(0,14);
   // total value
   if (MC_Data::size()>1 && have_total_)
-    fs_ << std::setw(14)<<"Total"<<std::setw(11)<<"err";
+    os << std::setw(14)<<"Total"<<std::setw(11)<<"err";
   for (const auto& name : elem_names_) 
-    fs_ << std::setw(14)<<name<<std::setw(11)<<"err";
-  //fs_ << std::setw(9)<<"samples";
-  fs_ << std::setw(9)<<"samples"<<std::setw(12)<<"converged"<<std::setw(6)<<"tau";
-  fs_ << std::endl;
-  fs_ << "#" << std::string(72, '-') << "\n";
-  fs_ << std::flush;
+    os << std::setw(14)<<name<<std::setw(11)<<"err";
+  //os << std::setw(9)<<"samples";
+  os << std::setw(9)<<"samples"<<std::setw(12)<<"converged"<<std::setw(6)<<"tau";
+  os << "\n";
+  os << "#" << std::string(72, '-') << "\n";
+  write_text(os.str());
   heading_printed_ = true;
-  close_file();
 }
 
 void MC_Observable::print_result(const std::vector<double>& xpvals) 
 {
   if (!is_on()) return;
-  if (!fs_.is_open()) open_file();
-  fs_ << std::right;
-  fs_ << std::scientific << std::uppercase << std::setprecision(6);
+  std::ostringstream os;
+  os << std::right;
+  os << std::scientific << std::uppercase << std::setprecision(6);
   for (const auto& p : xpvals) 
-    fs_ << std::setw(14) << p;
+    os << std::setw(14) << p;
   // total value
   //if (MC_Data::size()>1)
   if (MC_Data::size()>1 && have_total_)
-    fs_ << MC_Data::result_str(-1); 
+    os << MC_Data::result_str(-1); 
   for (unsigned i=0; i<MC_Data::size(); ++i) 
-    fs_ << MC_Data::result_str(i); 
-  fs_ << MC_Data::conv_str(0); //.substr(0,10); 
-  fs_ << std::endl;
-  fs_ << std::flush;
-  close_file();
+    os << MC_Data::result_str(i); 
+  os << MC_Data::conv_str(0); //.substr(0,10); 
+  os << "\n";
+  write_text(os.str());
 } 
 
+void MC_Observable::write_text(const std::string& text)
+{
+  // batched by the background writer; the first write replaces the file 
+  // in 'replace_mode' (as 'open_file' does)
+  writer_->write(fname_, text, replace_mode_);
+  replace_mode_ = false;
+}
+
 void MC_Observable::open_file(void) 
 {
   if (fs_.is_open()) return;
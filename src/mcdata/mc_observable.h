@@ -15,6 +15,7 @@
 #include <fstream>
 #include <iomanip>
 #include "mcdata.h"
+#include "async_writer.h"
 
 namespace mcdata {
 
@@ -38,6 +39,10 @@ public:
   void switch_off(void) { is_on_=false; if (fs_.is_open()) fs_.close(); }
   operator int(void) const { return is_on(); }
   const bool& is_on(void) const { return is_on_; }
+  // output goes through 'writer' (default: AsyncWriter::global())
+  void set_writer(AsyncWriter& writer) { writer_ = &writer; }
+  // durability point (checkpoints): results printed so far are on disk
+  void sync_file(void) { writer_->sync(); }
   void open_file(void); 
   void close_file(void); 
   bool is_open(void) const { return fs_.is_open(); }
@@ -51,6 +56,8 @@ protected:
   std::ofstream fs_;
   bool heading_printed_{false};
   bool replace_mode_{true};
+  AsyncWriter* writer_{&AsyncWriter::global()};
+  void write_text(const std::string& text);
 private:
   unsigned num_dataset_{0};
   MC_Data avg_mcdata_;
@@ -64,8 +64,8 @@ void DataBin::finalize(void) const
     num_samples_last_ = num_samples_;
     if (num_samples_ > 1) {
       mean_ = ssum_/num_samples_;
-      data_t variance_ = sumsq_/num_samples_ - mean_ * mean_;
-      stddev_ = variance_/(num_samples_-1);
+      // variance computed in place 
+      stddev_ = (sumsq_/num_samples_ - mean_ * mean_)/(num_samples_-1);
       stddev_ = stddev_.sqrt();
     }
     else {
@@ -84,6 +84,7 @@ void MC_Data::init(const std::string& name, const unsigned& size)
   top_bin = this->begin();
   end_bin = this->end();
   name_ = name;
+  scalar_sample_.resize(1);
   this->clear();
 }
 
@@ -107,10 +108,11 @@ void MC_Data::clear(void)
 
 void MC_Data::add_sample(const data_t& sample)
 {
+  // the carry of a bin is passed on to the next one, no copies
   auto this_bin = top_bin;  
-  data_t new_sample(sample);
-  while (this_bin->add_sample(new_sample)) {
-    new_sample = this_bin->carry();
+  const data_t* new_sample = &sample;
+  while (this_bin->add_sample(*new_sample)) {
+    new_sample = &this_bin->carry();
     //if (this_bin++ == end_bin) break; // wrong logic?
     if (++this_bin == end_bin) break;
   }
@@ -118,9 +120,8 @@ void MC_Data::add_sample(const data_t& sample)
 
 void MC_Data::add_sample(const double& sample)
 {
-  data_t new_sample(1);
-  new_sample << sample;
-  add_sample(new_sample);
+  scalar_sample_(0) = sample;
+  add_sample(scalar_sample_);
 }
 
 void MC_Data::operator<<(const data_t& sample) {
@@ -129,9 +130,7 @@ void MC_Data::operator<<(const data_t& sample) {
 
 void MC_Data::operator<<(const double& sample)
 {
-  data_t new_sample(1);
-  new_sample << sample;
-  add_sample(new_sample);
+  add_sample(sample);
 }
 
 const data_t& MC_Data::mean_data(void) const 
@@ -170,6 +169,18 @@ const double& MC_Data::tau(void) const
   return tau_;
 }
 
+bool MC_Data::converged(const int& n) const
+{
+  this->find_conv_and_tau(n);
+  return error_converged_ == "CONVERGED";
+}
+
+unsigned MC_Data::decorrelated_block_size(void) const
+{
+  this->finalize();
+  return (dcorr_level_ > 0) ? (1u << (dcorr_level_-1)) : 1;
+}
+
 void MC_Data::finalize(void)  const
 { 
   if (top_bin->have_new_samples()) {
@@ -189,14 +200,16 @@ void MC_Data::finalize(void)  const
 void MC_Data::find_conv_and_tau(const unsigned& n) const 
 { 
   this->finalize();
-  std::vector<double> xv, yv;
+  // at most 4 levels enter the fit
+  std::array<double,4> xv, yv;
+  unsigned num_points = 0;
   unsigned level_n = dcorr_level_;
   if (dcorr_level_ == 2) level_n = dcorr_level_-2;
   else if (dcorr_level_ >= 3) level_n = dcorr_level_-3;
   for (unsigned i=level_n; i<=dcorr_level_; ++i) {
-    xv.push_back(static_cast<double>(i));
-    data_t stddev = this->operator[](i).stddev();
-    yv.push_back(static_cast<double>(stddev(n)));
+    xv[num_points] = static_cast<double>(i);
+    yv[num_points] = static_cast<double>(this->operator[](i).stddev()(n));
+    ++num_points;
   }
   // assuming convergence
   double stddev_0 = static_cast<double>(this->operator[](0).stddev()(n));
@@ -208,28 +221,29 @@ void MC_Data::find_conv_and_tau(const unsigned& n) const
     tau_ = std::abs(tau_);
   }
   // 'tau' gets reset in case of non-convergence
-  this->check_convergence(xv, yv);
+  this->check_convergence(xv.data(), yv.data(), num_points);
   if (error_converged_ == "NOT_CONVD") tau_ = -1.0;
 }
 
-void MC_Data::check_convergence(const std::vector<double>& xv, const std::vector<double>& yv) const 
+void MC_Data::check_convergence(const double* xv, const double* yv, 
+  const unsigned& num_points) const 
 {
   error_converged_ = "NOT_CONVD";
-  if (xv.size() >= 3) {
+  if (num_points >= 3) {
     // slope of a least square fit straight line through these points
-    double a1 = static_cast<double>(xv.size());
+    double a1 = static_cast<double>(num_points);
     double b1 = 0.0;
-    for (const auto& x : xv) b1 += x;
+    for (unsigned i=0; i<num_points; ++i) b1 += xv[i];
     double c1 = 0.0;
-    for (const auto& y : yv) c1 += y;
+    for (unsigned i=0; i<num_points; ++i) c1 += yv[i];
     double a2 = b1;
     double b2 = 0.0;
-    for (const auto& x : xv) b2 += x*x;
+    for (unsigned i=0; i<num_points; ++i) b2 += xv[i]*xv[i];
     double c2 = 0.0;
-    for (unsigned i=0; i<xv.size(); ++i) c2 += xv[i]*yv[i];
+    for (unsigned i=0; i<num_points; ++i) c2 += xv[i]*yv[i];
     double slope = (c2 - c1*a2/a1)/(b2 - b1*a2/a1);
     //if (std::abs(slope) < 1.0E-4) {
-    if (std::abs(slope) < 0.1 * yv.back()) error_converged_ = "CONVERGED";
+    if (std::abs(slope) < 0.1 * yv[num_points-1]) error_converged_ = "CONVERGED";
   }
 } 
 
@@ -13,6 +13,7 @@
 #include <iomanip>
 #include <string>
 #include <vector>
+#include <array>
 #include <stdexcept>
 #include <Eigen/Core>
 
@@ -78,6 +79,9 @@ public:
   //const data_t& tau(void) const { finalize(); return tau_; } 
   const double& stddev(const int& n) const;
   const double& tau(void) const;
+  bool converged(const int& n=0) const;
+  // block size (2^level) of the bin the error bar is taken from
+  unsigned decorrelated_block_size(void) const;
   std::string result_str(const int& n=0) const; 
   std::string conv_str(const int& n=0) const; 
   const MC_Data& with_statistic(void) const { show_statistic_=true; return *this; }
@@ -96,9 +100,11 @@ private:
   mutable bool show_statistic_;
   mutable std::string error_converged_;
   mutable std::string convergence_str_;
+  data_t scalar_sample_;
 
   void find_conv_and_tau(const unsigned& n=0) const;
-  void check_convergence(const std::vector<double>& xv, const std::vector<double>& yv) const;
+  void check_convergence(const double* xv, const double* yv, 
+    const unsigned& num_points) const;
 };
 
 
@@ -0,0 +1,152 @@
+#include "./resampler.h"
+#include <atomic>
+#include <thread>
+#include <random>
+
+namespace mcdata {
+
+void Resampler::init(const unsigned& size, const unsigned& max_blocks) 
+{
+  if (max_blocks < 4) throw std::invalid_argument("Resampler::init: too few blocks");
+  size_ = size;
+  // even, so that the blocks merge pairwise
+  max_blocks_ = max_blocks - max_blocks%2;
+  block_sums_.resize(size_, max_blocks_);
+  current_sum_.resize(size_);
+  clear();
+}
+
+void Resampler::clear(void) 
+{
+  num_blocks_ = 0;
+  block_size_ = 1;
+  num_samples_ = 0;
+  current_count_ = 0;
+  block_sums_.setZero();
+  current_sum_.setZero();
+}
+
+void Resampler::add_sample(const data_t& sample)
+{
+  current_sum_ += sample;
+  ++num_samples_;
+  if (++current_count_ < block_size_) return;
+  block_sums_.col(num_blocks_++) = current_sum_;
+  current_sum_.setZero();
+  current_count_ = 0;
+  if (num_blocks_ == max_blocks_) {
+    // rebin: go to the next binning level
+    for (unsigned i=0; i<max_blocks_/2; ++i) 
+      block_sums_.col(i) = block_sums_.col(2*i) + block_sums_.col(2*i+1);
+    num_blocks_ = max_blocks_/2;
+    block_size_ *= 2;
+  }
+}
+
+unsigned Resampler::num_blocks(const std::uint64_t& min_block_size) const
+{
+  return num_blocks_/merge_factor(min_block_size);
+}
+
+std::uint64_t Resampler::merge_factor(const std::uint64_t& min_block_size) const
+{
+  // number of stored blocks merged into one
+  std::uint64_t m = 1;
+  while (m*block_size_ < min_block_size) m *= 2;
+  return m;
+}
+
+unsigned Resampler::get_blocks(const std::uint64_t& min_block_size, block_array& sums, 
+  data_t& counts) const
+{
+  // complete blocks only: the left over blocks and the incomplete one are 
+  // dropped, as the equal weight jackknife & bootstrap need equal blocks
+  std::uint64_t m = merge_factor(min_block_size);
+  unsigned n = num_blocks_/m;
+  sums.resize(size_, n);
+  counts.resize(n);
+  for (unsigned i=0; i<n; ++i) {
+    sums.col(i) = block_sums_.middleCols(i*m, m).rowwise().sum();
+    counts(i) = m*block_size_;
+  }
+  return n;
+}
+
+resample_result Resampler::jackknife(const derived_func& func, 
+  const std::uint64_t& min_block_size) const
+{
+  block_array sums;
+  data_t counts;
+  unsigned B = get_blocks(min_block_size, sums, counts);
+  if (B < 2) throw std::range_error("Resampler::jackknife: too few blocks");
+  data_t total = sums.rowwise().sum();
+  double N = counts.sum();
+  // leave-one-out means, all blocks at once
+  block_array means = (-sums).colwise() + total;
+  means.rowwise() /= (N-counts).transpose();
+  block_array f_full, f_jk;
+  func(total/N, f_full);
+  func(means, f_jk);
+  data_t f_avg = f_jk.rowwise().mean();
+  resample_result result;
+  result.num_blocks = B;
+  result.bias = (B-1)*(f_avg - f_full.col(0));
+  result.mean = f_full.col(0) - result.bias;
+  result.stddev = ((f_jk.colwise()-f_avg).square().rowwise().sum()*(B-1)/B).sqrt();
+  return result;
+}
+
+resample_result Resampler::bootstrap(const derived_func& func, const unsigned& num_resamples,
+  const int& num_threads, const std::uint64_t& seed, const std::uint64_t& min_block_size) const
+{
+  if (num_resamples<2 || num_threads<1) 
+    throw std::invalid_argument("Resampler::bootstrap: invalid input");
+  block_array sums;
+  data_t counts;
+  unsigned B = get_blocks(min_block_size, sums, counts);
+  if (B < 2) throw std::range_error("Resampler::bootstrap: too few blocks");
+
+  // resampled means, built in parallel in chunks with independent RNG streams
+  const unsigned chunk_size = 64;
+  unsigned num_chunks = (num_resamples+chunk_size-1)/chunk_size;
+  block_array means(size_, num_resamples);
+  std::atomic<unsigned> next_chunk(0);
+  auto work = [&](void) {
+    data_t sum(size_);
+    unsigned c;
+    while ((c=next_chunk.fetch_add(1)) < num_chunks) {
+      std::seed_seq seq{std::uint32_t(seed), std::uint32_t(seed>>32), std::uint32_t(c)};
+      std::mt19937_64 rng(seq);
+      std::uniform_int_distribution<unsigned> pick(0, B-1);
+      unsigned last = std::min(num_resamples, (c+1)*chunk_size);
+      for (unsigned r=c*chunk_size; r<last; ++r) {
+        sum.setZero();
+        double count = 0.0;
+        for (unsigned k=0; k<B; ++k) {
+          unsigned j = pick(rng);
+          sum += sums.col(j);
+          count += counts(j);
+        }
+        means.col(r) = sum/count;
+      }
+    }
+  };
+  std::vector<std::thread> workers;
+  for (int i=1; i<num_threads; ++i) workers.push_back(std::thread(work));
+  work();
+  for (auto& t : workers) t.join();
+
+  block_array f_full, f_bs;
+  func(sums.rowwise().sum()/counts.sum(), f_full);
+  func(means, f_bs);
+  data_t f_avg = f_bs.rowwise().mean();
+  resample_result result;
+  result.num_blocks = B;
+  result.bias = f_avg - f_full.col(0);
+  result.mean = f_full.col(0) - result.bias;
+  result.stddev = ((f_bs.colwise()-f_avg).square().rowwise().sum()/(num_resamples-1)).sqrt();
+  return result;
+}
+
+
+} // end namespace mcdata
@@ -0,0 +1,75 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <cstdint>
+#include <functional>
+#include "mcdata.h"
+
+namespace mcdata {
+
+using block_array = Eigen::ArrayXXd;
+
+// derived quantity f(means) of the primary observables, evaluated for all 
+// resamples at once: column 'r' of 'values' is f applied to column 'r' of 'means'
+using derived_func = std::function<void(const block_array& means, block_array& values)>;
+
+struct resample_result
+{
+  data_t mean;    // bias corrected
+  data_t stddev;
+  data_t bias;
+  unsigned num_blocks{0};
+};
+
+/*---------------------------------------------------------------------------
+* Jackknife & bootstrap errors of derived quantities. The primary observables
+* of a sample are accumulated jointly into at most 'max_blocks' block sums. 
+* When full, neighbouring blocks are merged and the block size doubles, so the
+* blocks are always those of a binning level of MC_Data (block size 2^k).
+* Adding a sample does not allocate. The resampling uses the complete blocks
+* only; the samples of a last, incomplete block (fewer than one block size) 
+* are left out.
+*----------------------------------------------------------------------------*/
+class Resampler
+{
+public:
+  Resampler() {}
+  Resampler(const unsigned& size, const unsigned& max_blocks=256) 
+    { init(size, max_blocks); }
+  ~Resampler() {}
+  void init(const unsigned& size, const unsigned& max_blocks=256);
+  void clear(void);
+  void add_sample(const data_t& sample);
+  void operator<<(const data_t& sample) { add_sample(sample); }
+  const std::uint64_t& num_samples(void) const { return num_samples_; }
+  const std::uint64_t& block_size(void) const { return block_size_; }
+  // complete blocks of at least 'min_block_size' samples
+  unsigned num_blocks(const std::uint64_t& min_block_size=1) const;
+  // blocks are merged further up to 'min_block_size' (e.g. the 
+  // decorrelated block size of MC_Data) before the resampling
+  resample_result jackknife(const derived_func& func, 
+    const std::uint64_t& min_block_size=1) const;
+  // resample 'r' uses its own RNG stream seeded by (seed, r/64), so the 
+  // result does not depend on the number of threads
+  resample_result bootstrap(const derived_func& func, const unsigned& num_resamples=1000, 
+    const int& num_threads=1, const std::uint64_t& seed=1, 
+    const std::uint64_t& min_block_size=1) const;
+private:
+  unsigned size_{0};
+  unsigned max_blocks_{0};
+  unsigned num_blocks_{0};  // complete blocks
+  std::uint64_t block_size_{1};
+  std::uint64_t num_samples_{0};
+  std::uint64_t current_count_{0};
+  block_array block_sums_;
+  data_t current_sum_;
+
+  std::uint64_t merge_factor(const std::uint64_t& min_block_size) const;
+  unsigned get_blocks(const std::uint64_t& min_block_size, block_array& sums, 
+    data_t& counts) const;
+};
+
+
+} // end namespace mcdata
+
+#endif
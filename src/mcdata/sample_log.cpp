@@ -0,0 +1,388 @@
+#include "./sample_log.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace mcdata {
+
+namespace {
+const char log_magic[8] = {'M','C','S','L','O','G','0','1'};
+const char index_magic[8] = {'M','C','S','L','O','G','I','X'};
+const std::uint32_t log_version = 1;
+const std::size_t trailer_size = 3*sizeof(std::uint64_t)+8;
+const std::size_t index_entry_size = 2*sizeof(std::uint64_t)+2*sizeof(std::uint32_t);
+
+template<typename T> T read_value(const unsigned char* p)
+{
+  T x;
+  std::memcpy(&x, p, sizeof(T));
+  return x;
+}
+}
+
+/*----------------------SampleLog class------------------*/
+void SampleLog::open(const std::string& fname, const std::vector<std::string>& column_names, 
+  const unsigned& block_rows, const bool& compress)
+{
+  close();
+  if (column_names.empty() || block_rows==0) 
+    throw std::invalid_argument("SampleLog::open: invalid input");
+  fname_ = fname;
+  num_columns_ = column_names.size();
+  block_rows_ = block_rows;
+  compress_ = compress;
+  num_rows_ = 0;
+  file_pos_ = 0;
+  rows_in_block_ = 0;
+  // all buffers sized here, 'append' does not allocate
+  block_.resize(num_columns_*block_rows_);
+  work_.resize(8*block_rows_);
+  packed_.resize(8*block_rows_ + block_rows_/16 + 16);
+  index_.clear();
+  index_.reserve(4096);
+  io_buffer_.resize(1<<20);
+  fs_ = std::fopen(fname_.c_str(), "wb");
+  if (fs_ == nullptr) throw std::runtime_error("SampleLog::open: file open failed");
+  std::setvbuf(fs_, io_buffer_.data(), _IOFBF, io_buffer_.size());
+  // header
+  std::uint32_t u;
+  write_bytes(log_magic, 8);
+  write_bytes(&log_version, sizeof(log_version));
+  u = num_columns_; write_bytes(&u, sizeof(u));
+  u = block_rows_; write_bytes(&u, sizeof(u));
+  u = compress_ ? 1 : 0; write_bytes(&u, sizeof(u));
+  for (const auto& name : column_names) {
+    u = name.size(); 
+    write_bytes(&u, sizeof(u));
+    write_bytes(name.data(), name.size());
+  }
+}
+
+void SampleLog::append(const data_t& sample)
+{
+  if (sample.size() != num_columns_) 
+    throw std::invalid_argument("SampleLog::append: sample size mismatch");
+  for (unsigned c=0; c<num_columns_; ++c) 
+    block_[c*block_rows_+rows_in_block_] = sample(c);
+  ++num_rows_;
+  if (++rows_in_block_ == block_rows_) write_block();
+}
+
+void SampleLog::write_block(void)
+{
+  block_info info;
+  info.offset = file_pos_;
+  info.num_rows = rows_in_block_;
+  for (unsigned c=0; c<num_columns_; ++c) {
+    const double* column = &block_[c*block_rows_];
+    std::uint32_t nbytes;
+    if (compress_) {
+      nbytes = pack_column(column, rows_in_block_, work_.data(), packed_.data());
+      write_bytes(&nbytes, sizeof(nbytes));
+      write_bytes(packed_.data(), nbytes);
+    }
+    else {
+      nbytes = sizeof(double)*rows_in_block_;
+      write_bytes(&nbytes, sizeof(nbytes));
+      write_bytes(column, nbytes);
+    }
+  }
+  info.nbytes = file_pos_-info.offset;
+  index_.push_back(info);
+  rows_in_block_ = 0;
+}
+
+void SampleLog::write_bytes(const void* bytes, const std::size_t& n)
+{
+  if (std::fwrite(bytes, 1, n, fs_) != n) 
+    throw std::runtime_error("SampleLog::write: write failed for '"+fname_+"'");
+  file_pos_ += n;
+}
+
+void SampleLog::close(void)
+{
+  if (fs_ == nullptr) return;
+  if (rows_in_block_ > 0) write_block();
+  // index & trailer
+  std::uint64_t index_offset = file_pos_;
+  std::uint32_t zero = 0;
+  for (const auto& info : index_) {
+    write_bytes(&info.offset, sizeof(info.offset));
+    write_bytes(&info.nbytes, sizeof(info.nbytes));
+    write_bytes(&info.num_rows, sizeof(info.num_rows));
+    write_bytes(&zero, sizeof(zero));
+  }
+  std::uint64_t num_blocks = index_.size();
+  write_bytes(&index_offset, sizeof(index_offset));
+  write_bytes(&num_blocks, sizeof(num_blocks));
+  write_bytes(&num_rows_, sizeof(num_rows_));
+  write_bytes(index_magic, 8);
+  std::fclose(fs_);
+  fs_ = nullptr;
+}
+
+/*----------------------SampleLogReader class------------------*/
+void SampleLogReader::open(const std::string& fname, const bool& recover)
+{
+  close();
+  int fd = ::open(fname.c_str(), O_RDONLY);
+  if (fd < 0) throw std::runtime_error("SampleLogReader::open: file open failed");
+  struct stat st;
+  if (fstat(fd, &st)!=0 || static_cast<std::size_t>(st.st_size)<28) {
+    ::close(fd);
+    throw std::runtime_error("SampleLogReader::open: '"+fname+"' is not a sample log");
+  }
+  map_size_ = st.st_size;
+  void* p = mmap(nullptr, map_size_, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED) throw std::runtime_error("SampleLogReader::open: mmap failed");
+  map_ = static_cast<const unsigned char*>(p);
+  try {
+    if (std::memcmp(map_, log_magic, 8) != 0) 
+      throw std::runtime_error("SampleLogReader::open: '"+fname+"' is not a sample log");
+    // header
+    std::size_t pos = 8+sizeof(std::uint32_t);
+    unsigned num_columns = read_value<std::uint32_t>(map_+pos); 
+    block_rows_ = read_value<std::uint32_t>(map_+pos+4); 
+    compressed_ = (read_value<std::uint32_t>(map_+pos+8) != 0); 
+    pos += 12;
+    if (num_columns==0 || block_rows_==0) throw_corrupt("header");
+    column_names_.resize(num_columns);
+    for (auto& name : column_names_) {
+      check_range(pos, 4, "header");
+      std::uint32_t len = read_value<std::uint32_t>(map_+pos); pos += 4;
+      check_range(pos, len, "header");
+      name.assign(reinterpret_cast<const char*>(map_+pos), len); pos += len;
+    }
+    data_offset_ = pos;
+    bool have_trailer = (map_size_ >= data_offset_+trailer_size && 
+      std::memcmp(map_+map_size_-8, index_magic, 8)==0);
+    if (have_trailer) read_index(map_+map_size_-trailer_size);
+    else if (recover) scan_blocks();
+    else throw std::runtime_error("SampleLogReader::open: '"+fname+
+      "' has no index (interrupted run?), open it with 'recover' set");
+  }
+  catch (...) {
+    close();
+    throw;
+  }
+  std::size_t max_rows = 0;
+  for (const auto& info : index_) max_rows = std::max<std::size_t>(max_rows, info.num_rows);
+  work_.resize(8*max_rows);
+}
+
+void SampleLogReader::read_index(const unsigned char* trailer)
+{
+  std::uint64_t index_offset = read_value<std::uint64_t>(trailer);
+  std::uint64_t num_blocks = read_value<std::uint64_t>(trailer+8);
+  std::uint64_t index_end = map_size_-trailer_size;
+  if (index_offset<data_offset_ || index_offset>index_end || 
+    num_blocks != (index_end-index_offset)/index_entry_size ||
+    (index_end-index_offset)%index_entry_size != 0) throw_corrupt("index");
+  num_rows_ = read_value<std::uint64_t>(trailer+16);
+  index_.resize(num_blocks);
+  const unsigned char* q = map_+index_offset;
+  std::uint64_t rows = 0;
+  for (auto& info : index_) {
+    info.offset = read_value<std::uint64_t>(q);
+    info.nbytes = read_value<std::uint64_t>(q+8);
+    info.num_rows = read_value<std::uint32_t>(q+16);
+    q += index_entry_size;
+    if (info.offset<data_offset_ || info.offset>index_offset || 
+      info.nbytes>index_offset-info.offset || info.num_rows>block_rows_) throw_corrupt("index");
+    check_block(info);
+    rows += info.num_rows;
+  }
+  if (rows != num_rows_) throw_corrupt("index");
+}
+
+void SampleLogReader::scan_blocks(void)
+{
+  // without the index, walk the blocks from the header on; a block that 
+  // runs past the end or does not decode ends the scan
+  index_.clear();
+  num_rows_ = 0;
+  std::size_t pos = data_offset_;
+  while (pos < map_size_) {
+    block_info info;
+    info.offset = pos;
+    info.num_rows = 0;
+    bool valid = true;
+    for (unsigned c=0; c<num_columns() && valid; ++c) {
+      if (map_size_-pos < 4) { valid = false; break; }
+      std::uint32_t nbytes = read_value<std::uint32_t>(map_+pos); pos += 4;
+      if (nbytes > map_size_-pos) { valid = false; break; }
+      std::size_t n = compressed_ ? unpacked_size(map_+pos, nbytes) : nbytes;
+      unsigned rows = n/sizeof(double);
+      if (n%sizeof(double)!=0 || rows==0 || rows>block_rows_ || 
+        (c>0 && rows!=info.num_rows)) valid = false;
+      info.num_rows = rows;
+      pos += nbytes;
+    }
+    if (!valid) break;
+    info.nbytes = pos-info.offset;
+    index_.push_back(info);
+    num_rows_ += info.num_rows;
+    // only the last block can be a partial one
+    if (info.num_rows < block_rows_) break;
+  }
+}
+
+void SampleLogReader::check_block(const block_info& info) const
+{
+  // every column must lie inside the block
+  std::uint64_t end = info.offset+info.nbytes;
+  std::uint64_t pos = info.offset;
+  for (unsigned c=0; c<num_columns(); ++c) {
+    if (end-pos < 4) throw_corrupt("block");
+    std::uint32_t nbytes = read_value<std::uint32_t>(map_+pos); pos += 4;
+    if (nbytes > end-pos) throw_corrupt("block");
+    if (!compressed_ && nbytes!=sizeof(double)*info.num_rows) throw_corrupt("block");
+    pos += nbytes;
+  }
+}
+
+void SampleLogReader::check_range(const std::size_t& pos, const std::size_t& n, 
+  const char* what) const
+{
+  if (pos>map_size_ || n>map_size_-pos) throw_corrupt(what);
+}
+
+void SampleLogReader::throw_corrupt(const char* what) const
+{
+  throw std::runtime_error(std::string("SampleLogReader::open: corrupt ")+what);
+}
+
+void SampleLogReader::close(void)
+{
+  if (map_ != nullptr) munmap(const_cast<unsigned char*>(map_), map_size_);
+  map_ = nullptr;
+  map_size_ = 0;
+  num_rows_ = 0;
+  block_rows_ = 0;
+  data_offset_ = 0;
+  column_names_.clear();
+  index_.clear();
+}
+
+unsigned SampleLogReader::read_block(const std::size_t& b, std::vector<double>& values) const
+{
+  const block_info& info = index_.at(b);
+  values.resize(info.num_rows*num_columns());
+  const unsigned char* q = map_+info.offset;
+  for (unsigned c=0; c<num_columns(); ++c) {
+    std::uint32_t nbytes = read_value<std::uint32_t>(q); q += 4;
+    double* column = values.data()+c*info.num_rows;
+    if (compressed_) unpack_column(q, nbytes, info.num_rows, work_.data(), column);
+    else std::memcpy(column, q, nbytes);
+    q += nbytes;
+  }
+  return info.num_rows;
+}
+
+void SampleLogReader::read_column(const unsigned& c, std::vector<double>& values) const
+{
+  if (c >= num_columns()) throw std::range_error("SampleLogReader::read_column: no such column");
+  values.resize(num_rows_);
+  std::size_t row = 0;
+  for (const auto& info : index_) {
+    const unsigned char* q = map_+info.offset;
+    // skip the columns before
+    for (unsigned i=0; i<c; ++i) q += 4 + read_value<std::uint32_t>(q);
+    std::uint32_t nbytes = read_value<std::uint32_t>(q); q += 4;
+    if (compressed_) unpack_column(q, nbytes, info.num_rows, work_.data(), values.data()+row);
+    else std::memcpy(values.data()+row, q, nbytes);
+    row += info.num_rows;
+  }
+}
+
+/*----------------------column codec------------------*/
+std::size_t pack_column(const double* values, const unsigned& n, 
+  unsigned char* work, unsigned char* packed)
+{
+  // XOR with the previous value, then split into byte planes
+  std::uint64_t prev = 0;
+  for (unsigned i=0; i<n; ++i) {
+    std::uint64_t bits;
+    std::memcpy(&bits, values+i, 8);
+    std::uint64_t x = bits ^ prev;
+    prev = bits;
+    for (unsigned p=0; p<8; ++p) work[p*n+i] = static_cast<unsigned char>(x >> (8*p));
+  }
+  // zero run-length encoding
+  std::size_t m = 8*static_cast<std::size_t>(n);
+  std::size_t i = 0;
+  std::size_t out = 0;
+  while (i < m) {
+    if (work[i] == 0) {
+      unsigned run = 1;
+      while (i+run<m && work[i+run]==0 && run<128) ++run;
+      packed[out++] = static_cast<unsigned char>(127+run);
+      i += run;
+    }
+    else {
+      // literal bytes up to the next pair of zeros
+      std::size_t start = i;
+      unsigned len = 0;
+      while (i<m && len<128 && !(work[i]==0 && i+1<m && work[i+1]==0)) { ++i; ++len; }
+      packed[out++] = static_cast<unsigned char>(len-1);
+      std::memcpy(packed+out, work+start, len);
+      out += len;
+    }
+  }
+  return out;
+}
+
+std::size_t unpacked_size(const unsigned char* packed, const std::size_t& nbytes)
+{
+  // decoded length of a column, 0 if the data is cut short
+  std::size_t i = 0;
+  std::size_t out = 0;
+  while (i < nbytes) {
+    unsigned c = packed[i++];
+    if (c < 128) {
+      if (c+1 > nbytes-i) return 0;
+      i += c+1;
+      out += c+1;
+    }
+    else out += c-127;
+  }
+  return out;
+}
+
+void unpack_column(const unsigned char* packed, const std::size_t& nbytes, 
+  const unsigned& n, unsigned char* work, double* values)
+{
+  std::size_t m = 8*static_cast<std::size_t>(n);
+  std::size_t i = 0;
+  std::size_t out = 0;
+  while (i<nbytes && out<m) {
+    unsigned c = packed[i++];
+    if (c < 128) {
+      if (c+1>nbytes-i || c+1>m-out) break;
+      std::memcpy(work+out, packed+i, c+1);
+      i += c+1;
+      out += c+1;
+    }
+    else {
+      if (c-127 > m-out) break;
+      std::memset(work+out, 0, c-127);
+      out += c-127;
+    }
+  }
+  if (out != m) throw std::runtime_error("mcdata::unpack_column: corrupt data");
+  std::uint64_t prev = 0;
+  for (unsigned i=0; i<n; ++i) {
+    std::uint64_t x = 0;
+    for (unsigned p=0; p<8; ++p) x |= static_cast<std::uint64_t>(work[p*n+i]) << (8*p);
+    prev ^= x;
+    std::memcpy(values+i, &prev, 8);
+  }
+}
+
+
+} // end namespace mcdata
@@ -0,0 +1,105 @@
+#ifndef SAMPLE_LOG_H
+#define SAMPLE_LOG_H
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "mcdata.h"
+
+namespace mcdata {
+
+/*---------------------------------------------------------------------------
+* Binary log of every measured sample vector, written in blocks of rows and 
+* stored column by column ('columnar'). File layout (little endian):
+*   header:  "MCSLOG01", u32 version, u32 num_columns, u32 block_rows, 
+*            u32 compressed, then per column: u32 length + name 
+*   blocks:  per column, u32 nbytes + (compressed) column data
+*   index:   per block, u64 offset, u64 nbytes, u32 num_rows, u32 0
+*   trailer: u64 index_offset, u64 num_blocks, u64 num_rows, "MCSLOGIX"
+* Compression of a column: each double is XOR-ed with the previous one, the
+* result is split into 8 byte planes and zero bytes are run-length encoded
+* (control byte c<128: c+1 literal bytes follow; c>=128: c-127 zero bytes).
+*----------------------------------------------------------------------------*/
+class SampleLog 
+{
+public:
+  SampleLog() {}
+  ~SampleLog() { close(); }
+  void open(const std::string& fname, const std::vector<std::string>& column_names, 
+    const unsigned& block_rows=4096, const bool& compress=true);
+  void close(void);
+  bool is_open(void) const { return fs_ != nullptr; }
+  void append(const data_t& sample);
+  void operator<<(const data_t& sample) { append(sample); }
+  const std::uint64_t& num_rows(void) const { return num_rows_; }
+private:
+  struct block_info { std::uint64_t offset; std::uint64_t nbytes; std::uint32_t num_rows; };
+  std::FILE* fs_{nullptr};
+  std::string fname_;
+  unsigned num_columns_{0};
+  unsigned block_rows_{0};
+  bool compress_{true};
+  std::uint64_t num_rows_{0};
+  std::uint64_t file_pos_{0};
+  unsigned rows_in_block_{0};
+  std::vector<double> block_;      // column-major block buffer
+  std::vector<unsigned char> work_;
+  std::vector<unsigned char> packed_;
+  std::vector<block_info> index_;
+  std::vector<char> io_buffer_;
+  void write_block(void);
+  void write_bytes(const void* bytes, const std::size_t& n);
+};
+
+/*---------------------------------------------------------------------------
+* Reads a SampleLog file through a read-only memory map. Offsets in the file
+* are checked against its size, a corrupt file throws. A log without the 
+* trailer (run interrupted) is read with 'recover' set: the blocks are then
+* found by walking them from the header, up to the first incomplete one.
+*----------------------------------------------------------------------------*/
+class SampleLogReader
+{
+public:
+  SampleLogReader() {}
+  SampleLogReader(const std::string& fname, const bool& recover=false) 
+    { open(fname, recover); }
+  ~SampleLogReader() { close(); }
+  void open(const std::string& fname, const bool& recover=false);
+  void close(void);
+  const std::uint64_t& num_rows(void) const { return num_rows_; }
+  unsigned num_columns(void) const { return column_names_.size(); }
+  std::size_t num_blocks(void) const { return index_.size(); }
+  const std::vector<std::string>& column_names(void) const { return column_names_; }
+  // block 'b' as a (num_rows x num_columns) column-major array
+  unsigned read_block(const std::size_t& b, std::vector<double>& values) const;
+  void read_column(const unsigned& c, std::vector<double>& values) const;
+private:
+  struct block_info { std::uint64_t offset; std::uint64_t nbytes; std::uint32_t num_rows; };
+  const unsigned char* map_{nullptr};
+  std::size_t map_size_{0};
+  bool compressed_{true};
+  unsigned block_rows_{0};
+  std::size_t data_offset_{0};
+  std::uint64_t num_rows_{0};
+  std::vector<std::string> column_names_;
+  std::vector<block_info> index_;
+  mutable std::vector<unsigned char> work_;
+  void read_index(const unsigned char* trailer);
+  void scan_blocks(void);
+  void check_block(const block_info& info) const;
+  void check_range(const std::size_t& pos, const std::size_t& n, const char* what) const;
+  [[noreturn]] void throw_corrupt(const char* what) const;
+};
+
+// column codec (see above)
+std::size_t pack_column(const double* values, const unsigned& n, 
+  unsigned char* work, unsigned char* packed);
+void unpack_column(const unsigned char* packed, const std::size_t& nbytes, 
+  const unsigned& n, unsigned char* work, double* values);
+std::size_t unpacked_size(const unsigned char* packed, const std::size_t& nbytes);
+
+
+} // end namespace mcdata
+
+#endif
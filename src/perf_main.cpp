@@ -0,0 +1,226 @@
+/* Throughput regression check of whole runs ('make perf'):
+*    perf.out [input_file] [name=value ...]
+*  sizes        = 4,8,12        linear sizes L of the LxL SQUARE lattice
+*  threads      = 0,2           measurement threads ('measure_threads')
+*  samples      = 2000          samples per run (fixed seed, BCS wavefunction)
+*  repeats      = 3             runs per configuration, the fastest one counts
+*  baseline     = perf_baseline.txt
+*  update       = false         (re)write the baseline from this run
+*  tolerance    = 0.15          allowed relative drop of a throughput
+*  energy_sigma = 4.0           allowed energy shift, in combined error bars
+*  Every configuration of the sizes x threads matrix is run and its sweeps/s,
+*  measurements/s and effective (independent) samples/s are compared with
+*  the baseline; the exit status is 2 if any of them regressed. The energy
+*  must agree with the baseline within 'energy_sigma' error bars (another 
+*  compiler or vectorisation legitimately changes the last bits), and 
+*  exactly with the threads=0 run of the same size in this binary (the 
+*  pipeline measures the same chain as the sampling thread). Baselines are 
+*  machine specific, record one on the machine the check runs on. */
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <cmath>
+#include "vmc.h"
+
+struct perf_result
+{
+  int L;
+  int threads;
+  double sweeps_per_s;
+  double samples_per_s;
+  double effective_per_s;
+  double energy;
+  double energy_err;
+  std::string key(void) const
+    { return "L="+std::to_string(L)+",threads="+std::to_string(threads); }
+};
+
+// the fastest of 'repeats' runs (the energy is the same for all of them)
+perf_result run_config(const int& L, const int& threads, const int& samples,
+  const int& repeats)
+{
+  perf_result r{L, threads, 0.0, 0.0, 0.0, 0.0, 0.0};
+  for (int n=0; n<repeats; ++n) {
+    input::Parameters inputs;
+    inputs.set("L1", std::to_string(L));
+    inputs.set("L2", std::to_string(L));
+    inputs.set("measure_threads", std::to_string(threads));
+    inputs.set("samples", std::to_string(samples));
+    inputs.set("seed", "1");
+    inputs.set("profile_report", "");
+    VMC vmc;
+    // the run's own output is not wanted here
+    std::ostringstream sink;
+    std::streambuf* cout_buf = std::cout.rdbuf(sink.rdbuf());
+    try {
+      vmc.init(inputs);
+      vmc.run_simulation();
+    }
+    catch (...) {
+      std::cout.rdbuf(cout_buf);
+      throw;
+    }
+    std::cout.rdbuf(cout_buf);
+    const run_stats& s = vmc.last_run();
+    if (s.seconds <= 0.0) continue;
+    if (s.sweeps/s.seconds > r.sweeps_per_s) {
+      r.sweeps_per_s = s.sweeps/s.seconds;
+      r.samples_per_s = s.samples/s.seconds;
+      r.effective_per_s = s.effective_samples/s.seconds;
+    }
+    r.energy = s.energy;
+    r.energy_err = s.energy_err;
+  }
+  return r;
+}
+
+// baseline lines: 'key sweeps/s samples/s effective/s energy error'
+bool read_baseline(const std::string& fname, std::map<std::string,perf_result>& baseline)
+{
+  std::ifstream fs(fname);
+  if (!fs) return false;
+  std::string line;
+  while (std::getline(fs, line)) {
+    if (line.empty() || line[0]=='#') continue;
+    std::istringstream is(line);
+    std::string key;
+    perf_result r{0, 0, 0.0, 0.0, 0.0, 0.0, 0.0};
+    if (is >> key >> r.sweeps_per_s >> r.samples_per_s >> r.effective_per_s
+      >> r.energy >> r.energy_err) baseline[key] = r;
+  }
+  return true;
+}
+
+bool write_baseline(const std::string& fname, const std::vector<perf_result>& results)
+{
+  std::ofstream fs(fname);
+  fs << "# key sweeps/s samples/s effective/s energy error\n";
+  fs << std::setprecision(8);
+  for (const auto& r : results) {
+    fs << r.key() << " " << r.sweeps_per_s << " " << r.samples_per_s << " "
+       << r.effective_per_s << " " << r.energy << " " << r.energy_err << "\n";
+  }
+  return static_cast<bool>(fs);
+}
+
+int main(int argc, const char *argv[])
+{
+  std::vector<double> sizes, threads;
+  int samples, repeats;
+  std::string baseline_file;
+  bool update;
+  double tolerance, energy_sigma;
+  try {
+    input::Parameters inputs(argc, argv);
+    sizes = inputs.set_vector("sizes", {4, 8, 12});
+    threads = inputs.set_vector("threads", {0, 2});
+    samples = inputs.set_value("samples", 2000);
+    repeats = std::max(inputs.set_value("repeats", 3), 1);
+    baseline_file = inputs.set_value("baseline", "perf_baseline.txt");
+    update = inputs.set_value("update", false);
+    tolerance = inputs.set_value("tolerance", 0.15);
+    energy_sigma = inputs.set_value("energy_sigma", 4.0);
+    if (!inputs.unused().empty())
+      throw std::invalid_argument("perf: unknown input parameter "+inputs.unused()[0]);
+  }
+  catch (const std::exception& e) {
+    std::cout << e.what() << "\n";
+    return 1;
+  }
+
+  std::map<std::string,perf_result> baseline;
+  bool have_baseline = !update && read_baseline(baseline_file, baseline);
+  if (!update && !have_baseline) {
+    std::cout << "perf: no baseline " << baseline_file << ", recording one\n";
+  }
+
+  std::vector<perf_result> results;
+  // energies of the threads=0 runs, by size
+  std::map<int,double> inline_energy;
+  int num_failed = 0;
+  std::cout << std::left << std::setw(20) << "config" << std::right
+    << std::setw(11) << "sweeps/s" << std::setw(11) << "samples/s"
+    << std::setw(11) << "eff/s" << std::setw(24) << "energy" << "  vs baseline\n";
+  for (double x : sizes) {
+    for (double t : threads) {
+      perf_result r;
+      try {
+        r = run_config(static_cast<int>(x), static_cast<int>(t), samples, repeats);
+      }
+      catch (const std::exception& e) {
+        std::cout << e.what() << "\n";
+        return 1;
+      }
+      results.push_back(r);
+      if (r.threads == 0) inline_energy[r.L] = r.energy;
+      // the same chain is measured with & without the pipeline
+      auto ref = inline_energy.find(r.L);
+      bool energy_differs = ref!=inline_energy.end() && r.energy!=ref->second;
+      std::ostringstream energy;
+      energy << r.energy << " +/- " << std::setprecision(2) << r.energy_err;
+      std::cout << std::left << std::setw(20) << r.key() << std::right
+        << std::fixed << std::setprecision(1) << std::setw(11) << r.sweeps_per_s
+        << std::setw(11) << r.samples_per_s << std::setw(11) << r.effective_per_s;
+      std::cout.unsetf(std::ios_base::floatfield);
+      std::cout << std::setprecision(6) << std::setw(24) << energy.str() << "  ";
+      if (!have_baseline || baseline.find(r.key())==baseline.end()) {
+        std::cout << (have_baseline ? "not in baseline" : "-");
+        if (energy_differs) {
+          num_failed++;
+          std::cout << "  REGRESSED: energy (threads=0)";
+        }
+        std::cout << "\n";
+        continue;
+      }
+      auto it = baseline.find(r.key());
+      const perf_result& b = it->second;
+      // throughputs may drop by 'tolerance' at most
+      std::vector<std::string> failed;
+      if (r.sweeps_per_s < (1.0-tolerance)*b.sweeps_per_s) failed.push_back("sweeps/s");
+      if (r.samples_per_s < (1.0-tolerance)*b.samples_per_s) failed.push_back("samples/s");
+      if (r.effective_per_s < (1.0-tolerance)*b.effective_per_s) failed.push_back("eff/s");
+      double sigma = std::sqrt(r.energy_err*r.energy_err + b.energy_err*b.energy_err);
+      if (std::abs(r.energy-b.energy) > energy_sigma*sigma) failed.push_back("energy");
+      if (energy_differs) failed.push_back("energy (threads=0)");
+      std::cout << std::fixed << std::setprecision(2) << "x" << r.sweeps_per_s/b.sweeps_per_s;
+      std::cout.unsetf(std::ios_base::floatfield);
+      std::cout << std::setprecision(6);
+      if (failed.empty()) std::cout << "  ok\n";
+      else {
+        num_failed++;
+        std::cout << "  REGRESSED:";
+        for (const auto& m : failed) std::cout << " " << m;
+        std::cout << "\n";
+      }
+    }
+  }
+
+  // scaling: cost per sweep & site, and speedup over the first thread count
+  std::cout << "\n" << std::left << std::setw(20) << "config" << std::right
+    << std::setw(14) << "ns/(sweep*N)" << std::setw(11) << "speedup" << "\n";
+  for (std::size_t i=0; i<results.size(); ++i) {
+    const perf_result& r = results[i];
+    const perf_result& ref = results[i-i%threads.size()];
+    std::cout << std::left << std::setw(20) << r.key() << std::right << std::fixed
+      << std::setprecision(1) << std::setw(14) << 1.0E+9/(r.sweeps_per_s*r.L*r.L)
+      << std::setprecision(2) << std::setw(11) << r.sweeps_per_s/ref.sweeps_per_s << "\n";
+    std::cout.unsetf(std::ios_base::floatfield);
+  }
+
+  if (num_failed > 0) {
+    std::cout << "perf: " << num_failed << " configuration(s) regressed\n";
+    return 2;
+  }
+  if (!have_baseline) {
+    if (!write_baseline(baseline_file, results)) {
+      std::cout << "perf: can't write " << baseline_file << "\n";
+      return 1;
+    }
+    std::cout << "baseline written to " << baseline_file << "\n";
+    return 0;
+  }
+  std::cout << "perf: no regressions\n";
+  return 0;
+}
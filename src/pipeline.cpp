@@ -0,0 +1,124 @@
+// File: pipeline.cpp
+#include <stdexcept>
+#include "pipeline.h"
+
+void MeasurePipeline::start(const SysConfig& config, const int& num_threads, 
+  const int& capacity, const unsigned& result_size, const measure_func& measure)
+{
+  if (is_running()) stop();
+  if (num_threads<1) 
+    throw std::invalid_argument("MeasurePipeline::start: invalid thread number");
+  // ring must be deep enough to keep every thread busy
+  capacity_ = std::max(capacity, 2*num_threads);
+  capacity_ = std::max(capacity_, 4L);
+  slots_.reset(new slot_t[capacity_]);
+  for (long i=0; i<capacity_; ++i) {
+    slots_[i].seq.store(i, std::memory_order_relaxed);
+    // sizes the snapshot buffers
+    config.take_snapshot(slots_[i].snapshot);
+    slots_[i].result.resize(result_size);
+    slots_[i].result.setZero();
+  }
+  head_ = 0;
+  tail_ = 0;
+  num_stalls_ = 0;
+  claim_.store(0);
+  num_pushed_.store(0);
+  closing_.store(false);
+  num_sleeping_.store(0);
+  num_started_.store(0);
+  measure_ = measure;
+  for (int i=0; i<num_threads; ++i) 
+    workers_.push_back(std::thread(&MeasurePipeline::work, this, i+1));
+  while (num_started_.load(std::memory_order_acquire) < num_threads) std::this_thread::yield();
+}
+
+bool MeasurePipeline::push(const SysConfig& config)
+{
+  slot_t& slot = slots_[head_ % capacity_];
+  if (slot.seq.load(std::memory_order_acquire) != head_) return false;
+  config.take_snapshot(slot.snapshot);
+  // (seq_cst with 'num_sleeping_': a worker going to sleep sees the slot 
+  // filled or is seen sleeping here)
+  slot.seq.store(head_+1, std::memory_order_seq_cst);
+  ++head_;
+  num_pushed_.store(head_, std::memory_order_release);
+  if (num_sleeping_.load(std::memory_order_seq_cst) > 0) {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    wake_.notify_all();
+  }
+  return true;
+}
+
+bool MeasurePipeline::wait_slot(mcdata::data_t& result)
+{
+  if (!is_full()) return false;
+  ++num_stalls_;
+  while (!pop_result(result)) std::this_thread::yield();
+  return true;
+}
+
+bool MeasurePipeline::pop_result(mcdata::data_t& result)
+{
+  if (tail_ == head_) return false;
+  slot_t& slot = slots_[tail_ % capacity_];
+  if (slot.seq.load(std::memory_order_acquire) != tail_+2) return false;
+  result = slot.result;
+  slot.seq.store(tail_+capacity_, std::memory_order_release);
+  ++tail_;
+  return true;
+}
+
+bool MeasurePipeline::wait_result(mcdata::data_t& result)
+{
+  while (tail_ != head_) {
+    if (pop_result(result)) return true;
+    std::this_thread::yield();
+  }
+  return false;
+}
+
+void MeasurePipeline::finish(void)
+{
+  closing_.store(true, std::memory_order_seq_cst);
+  std::lock_guard<std::mutex> lock(wake_mutex_);
+  wake_.notify_all();
+}
+
+void MeasurePipeline::stop(void)
+{
+  finish();
+  for (auto& w : workers_) w.join();
+  workers_.clear();
+}
+
+void MeasurePipeline::work(const int& id)
+{
+  trace::set_thread_name("measure", id);
+  num_started_.fetch_add(1, std::memory_order_release);
+  while (true) {
+    long t = claim_.fetch_add(1, std::memory_order_relaxed);
+    slot_t& slot = slots_[t % capacity_];
+    auto ready = [this,&slot,t](void) 
+      { return slot.seq.load(std::memory_order_seq_cst) == t+1 || 
+        closing_.load(std::memory_order_seq_cst); };
+    // spin a little, then sleep until the next push
+    for (int n=0; n<64 && !ready(); ++n) std::this_thread::yield();
+    if (!ready()) {
+      std::unique_lock<std::mutex> lock(wake_mutex_);
+      num_sleeping_.fetch_add(1, std::memory_order_seq_cst);
+      wake_.wait(lock, ready);
+      num_sleeping_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    if (slot.seq.load(std::memory_order_acquire) != t+1) {
+      // closing: every pushed snapshot is claimed by some worker
+      if (t >= num_pushed_.load(std::memory_order_acquire)) return;
+      while (slot.seq.load(std::memory_order_acquire) != t+1) std::this_thread::yield();
+    }
+    {
+      TRACE_SCOPE("measure");
+      measure_(slot.snapshot, slot.result);
+    }
+    slot.seq.store(t+2, std::memory_order_release);
+  }
+}
@@ -0,0 +1,79 @@
+// File: pipeline.h
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <vector>
+#include <functional>
+#include "sysconfig.h"
+#include "mcdata/mcdata.h"
+
+/*---------------------------------------------------------------------------
+* Measurement pipeline. The sampler thread pushes configuration snapshots 
+* into a bounded lock-free ring, measurement threads evaluate the observables 
+* on them and the sampler collects the results back in sample order (so that 
+* the binning analysis sees the true Markov chain order). 
+* Each ring slot carries a sequence number 'seq'. For ticket 't':
+*   seq == t     slot free
+*   seq == t+1   snapshot filled, waiting for measurement
+*   seq == t+2   measured, waiting to be collected
+* With a full ring the sampler first waits for the oldest measurement 
+* ('wait_slot'), so the chain is still measured every 'interval' sweeps and 
+* a run gives the same results as inline measurement for the same seed. 
+* Idle measurement threads sleep on a condition variable, 'push' wakes them.
+* 'start' returns once every thread is up (with its trace ring, if tracing, 
+* so that nothing allocates later in the sampling loop).
+*----------------------------------------------------------------------------*/
+class MeasurePipeline
+{
+public:
+  using measure_func = std::function<void(config_snapshot&, mcdata::data_t&)>;
+  MeasurePipeline() {}
+  ~MeasurePipeline() { stop(); }
+  void start(const SysConfig& config, const int& num_threads, const int& capacity, 
+    const unsigned& result_size, const measure_func& measure);
+  // false if the ring is full
+  bool push(const SysConfig& config);
+  // if the ring is full: waits for its oldest result and frees the slot (true)
+  bool wait_slot(mcdata::data_t& result);
+  bool pop_result(mcdata::data_t& result);
+  bool wait_result(mcdata::data_t& result);
+  void finish(void);
+  void stop(void);
+  bool is_running(void) const { return !workers_.empty(); }
+  long num_pending(void) const { return head_-tail_; }
+  bool is_full(void) const { return head_-tail_ >= capacity_; }
+  const long& num_stalls(void) const { return num_stalls_; }
+private:
+  struct slot_t 
+  {
+    std::atomic<long> seq;
+    config_snapshot snapshot;
+    mcdata::data_t result;
+  };
+  long capacity_{0};
+  std::unique_ptr<slot_t[]> slots_;
+  // sampler side
+  long head_{0};
+  long tail_{0};
+  long num_stalls_{0};
+  // measurement side
+  std::atomic<long> claim_{0};
+  std::atomic<long> num_pushed_{0};
+  std::atomic<bool> closing_{false};
+  std::atomic<int> num_sleeping_{0};
+  std::atomic<int> num_started_{0};
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+  measure_func measure_;
+  std::vector<std::thread> workers_;
+
+  void work(const int& id);
+};
+
+
+#endif
@@ -0,0 +1,66 @@
+// File: replay.cpp
+#include <atomic>
+#include <thread>
+#include <stdexcept>
+#include "replay.h"
+
+std::uint64_t ConfigReplay::run(const std::string& archive_file, const int& num_threads, 
+  const unsigned& result_size, const measure_func& measure, const collect_func& collect)
+{
+  if (num_threads<1) 
+    throw std::invalid_argument("ConfigReplay::run: invalid thread number");
+  ConfigArchiveReader archive(archive_file);
+  const FockBasis& basis = config_.basis_state();
+  if (2*archive.num_sites()!=basis.state().size() || 
+    archive.num_upspins()!=basis.upspin_sites().size() || 
+    archive.num_dnspins()!=basis.dnspin_sites().size()) {
+    throw std::invalid_argument("ConfigReplay::run: archive is not of this system");
+  }
+
+  // results of one chunk of records
+  const std::uint64_t chunk_size = 4096;
+  std::vector<mcdata::data_t> results(chunk_size, mcdata::data_t(result_size));
+  std::vector<std::uint64_t> sweeps(chunk_size);
+  std::vector<char> valid(chunk_size);
+  std::vector<config_snapshot> snapshots(num_threads);
+  std::vector<ivector> states(num_threads);
+  std::vector<ivector> canonical_states(num_threads);
+  // the archive is in the canonical site order
+  const Lattice& lattice = config_.lattice();
+  int num_sites = lattice.num_sites();
+
+  num_skipped_ = 0;
+  std::uint64_t num_done = 0;
+  for (std::uint64_t first=0; first<archive.num_records(); first+=chunk_size) {
+    std::uint64_t n = std::min(chunk_size, archive.num_records()-first);
+    std::atomic<std::uint64_t> next(0);
+    auto work = [&](const int& id) {
+      std::uint64_t i;
+      while ((i=next.fetch_add(1)) < n) {
+        ivector& canonical = canonical_states[id];
+        ivector& state = states[id];
+        sweeps[i] = archive.read(first+i, canonical);
+        state.resize(canonical.size());
+        for (int s=0; s<num_sites; ++s) {
+          state[s] = canonical[lattice.canonical_site(s)];
+          state[num_sites+s] = canonical[num_sites+lattice.canonical_site(s)];
+        }
+        valid[i] = config_.load_snapshot(states[id], snapshots[id]);
+        if (valid[i]) measure(snapshots[id], results[i]);
+      }
+    };
+    std::vector<std::thread> workers;
+    for (int id=1; id<num_threads; ++id) workers.push_back(std::thread(work, id));
+    work(0);
+    for (auto& t : workers) t.join();
+    // in archive order
+    for (std::uint64_t i=0; i<n; ++i) {
+      if (valid[i]) {
+        collect(sweeps[i], results[i]);
+        ++num_done;
+      }
+      else ++num_skipped_;
+    }
+  }
+  return num_done;
+}
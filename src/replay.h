@@ -0,0 +1,33 @@
+// File: replay.h
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <functional>
+#include "sysconfig.h"
+#include "config_archive.h"
+#include "mcdata/mcdata.h"
+
+/*---------------------------------------------------------------------------
+* Evaluates estimators on the configurations of a ConfigArchive. Records are
+* processed in chunks by 'num_threads' threads, each rebuilding 'psi_inv' for 
+* its snapshot, and the results are handed to 'collect' in archive order (so
+* that a binning analysis sees the original chain order). 
+*----------------------------------------------------------------------------*/
+class ConfigReplay
+{
+public:
+  using measure_func = std::function<void(config_snapshot&, mcdata::data_t&)>;
+  using collect_func = std::function<void(const std::uint64_t& sweep, const mcdata::data_t&)>;
+  ConfigReplay(const SysConfig& config) : config_(config) {}
+  ~ConfigReplay() {}
+  // returns the number of records evaluated
+  std::uint64_t run(const std::string& archive_file, const int& num_threads, 
+    const unsigned& result_size, const measure_func& measure, const collect_func& collect);
+  const std::uint64_t& num_skipped(void) const { return num_skipped_; }
+private:
+  const SysConfig& config_;
+  std::uint64_t num_skipped_{0};
+};
+
+
+#endif
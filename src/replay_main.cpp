@@ -0,0 +1,28 @@
+// Replays an archive of sampled configurations (see VMC::set_config_archive)
+#include <iostream>
+#include <cstdlib>
+#include "vmc.h"
+
+int main(int argc, const char *argv[])
+{
+  if (argc < 2) {
+    std::cout << "usage: " << argv[0] << " archive_file [input_file] [name=value ...]\n";
+    std::cout << "  (the inputs of the sampling run, and 'replay_threads')\n";
+    return 1;
+  }
+  VMC vmc;
+  int num_threads;
+
+  try {
+    // the archive takes the place of the program name
+    input::Parameters inputs(argc-1, argv+1);
+    num_threads = inputs.set_value("replay_threads", 1);
+    vmc.init(inputs);
+    vmc.replay(argv[1], num_threads);
+  }
+  catch (const std::exception& e) {
+    std::cout << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,78 @@
+// File: result_store.cpp
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cmath>
+#include "result_store.h"
+
+void ResultStore::open(const std::string& fname)
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  fname_ = fname;
+  results_.clear();
+  // a missing file is an empty store
+  std::ifstream fs(fname);
+  std::string line;
+  const std::string sep(" | ");
+  while (std::getline(fs, line)) {
+    if (fs.eof()) break; // no newline: incomplete
+    std::size_t pos = line.find(sep);
+    if (pos == std::string::npos) continue;
+    std::istringstream is(line.substr(0,pos));
+    stored_result r;
+    if (!(is >> r.mean >> r.stddev >> r.tau >> r.num_samples >> r.cost >> r.num_topups)) continue;
+    results_[line.substr(pos+sep.size())] = r;
+  }
+}
+
+int ResultStore::size(void) const
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  return results_.size();
+}
+
+bool ResultStore::find(const std::string& spec, stored_result& result) const
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  auto it = results_.find(spec);
+  if (it == results_.end()) return false;
+  result = it->second;
+  return true;
+}
+
+void ResultStore::put(const std::string& spec, const stored_result& result)
+{
+  if (!is_open()) throw std::logic_error("ResultStore::put: store not open");
+  if (spec.find('\n') != std::string::npos) 
+    throw std::invalid_argument("ResultStore::put: multi-line spec");
+  std::ostringstream line;
+  line << std::setprecision(17) << result.mean << " " << result.stddev << " " 
+    << result.tau << " " << result.num_samples << " " << result.cost << " " 
+    << result.num_topups << " | " << spec << "\n";
+  std::lock_guard<std::mutex> lock(mtx_);
+  results_[spec] = result;
+  mcdata::AsyncWriter::global().write(fname_, line.str());
+}
+
+stored_result ResultStore::combine(const stored_result& r1, const stored_result& r2)
+{
+  // sample weighted mean; the error bars add in quadrature with the same 
+  // weights. An unknown (negative) error or tau is left out: the known one
+  // is scaled to all the samples (err ~ 1/sqrt(N)), unknown if both are.
+  stored_result r;
+  r.num_samples = r1.num_samples + r2.num_samples;
+  if (r.num_samples == 0) return r;
+  double w1 = static_cast<double>(r1.num_samples)/r.num_samples;
+  double w2 = static_cast<double>(r2.num_samples)/r.num_samples;
+  r.mean = w1*r1.mean + w2*r2.mean;
+  if (r1.stddev>=0.0 && r2.stddev>=0.0) 
+    r.stddev = std::sqrt(w1*w1*r1.stddev*r1.stddev + w2*w2*r2.stddev*r2.stddev);
+  else if (r1.stddev >= 0.0) r.stddev = r1.stddev*std::sqrt(w1);
+  else if (r2.stddev >= 0.0) r.stddev = r2.stddev*std::sqrt(w2);
+  else r.stddev = -1.0;
+  if (r1.tau>=0.0 && r2.tau>=0.0) r.tau = w1*r1.tau + w2*r2.tau;
+  else r.tau = (r1.tau >= 0.0) ? r1.tau : r2.tau;
+  r.cost = r1.cost + r2.cost;
+  r.num_topups = r1.num_topups + r2.num_topups + 1;
+  return r;
+}
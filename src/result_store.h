@@ -0,0 +1,50 @@
+// File: result_store.h
+#ifndef RESULT_STORE_H
+#define RESULT_STORE_H
+
+#include <string>
+#include <map>
+#include <mutex>
+#include "mcdata/async_writer.h"
+
+// result of a run, as kept in the store (a negative stddev or tau: 
+// unknown, too few samples or no converged binning)
+struct stored_result
+{
+  double mean{0.0};
+  double stddev{0.0};
+  double tau{0.0};
+  unsigned long num_samples{0};
+  double cost{0.0};  // wall time (s), summed over the runs
+  int num_topups{0};
+};
+
+/*---------------------------------------------------------------------------
+* Persistent store of run results, keyed by the full run specification (a 
+* text such as made by 'VMC::run_spec'). The file is a log of lines
+*   mean stddev tau samples cost topups | spec
+* appended through the AsyncWriter; on 'open' the last line of each spec 
+* wins, and an incomplete last line (interrupted run) is ignored.
+* Lookups and updates are thread-safe.
+*----------------------------------------------------------------------------*/
+class ResultStore
+{
+public:
+  ResultStore() {}
+  ~ResultStore() {}
+  void open(const std::string& fname);
+  bool is_open(void) const { return !fname_.empty(); }
+  int size(void) const;
+  bool find(const std::string& spec, stored_result& result) const;
+  void put(const std::string& spec, const stored_result& result);
+  void sync(void) { mcdata::AsyncWriter::global().sync(); }
+  // results of two independent runs of the same spec, as one
+  static stored_result combine(const stored_result& r1, const stored_result& r2);
+private:
+  std::string fname_;
+  std::map<std::string, stored_result> results_;
+  mutable std::mutex mtx_;
+};
+
+
+#endif
@@ -0,0 +1,51 @@
+// File: sweep.cpp
+#include <algorithm>
+#include "sweep.h"
+
+void ParamSweep::make_points(const lattice_id& id, const lattice_bc& bc, 
+  const int& num_vparams, const site_order& order)
+{
+  std::vector<lattice_size> sizes(sizes_);
+  std::vector<double> dopings(dopings_);
+  std::vector<RealVector> vparams(vparams_);
+  std::vector<unsigned> seeds(seeds_);
+  if (sizes.empty()) sizes.push_back(lattice_size(4,4));
+  if (dopings.empty()) dopings.push_back(0.0);
+  if (vparams.empty()) vparams.push_back(RealVector::Ones(num_vparams));
+  if (seeds.empty()) seeds.push_back(1);
+  for (const auto& v : vparams) {
+    if (v.size() != num_vparams) 
+      throw std::invalid_argument("ParamSweep::make_points: wrong number of vparams");
+  }
+  // the lattices
+  lattices_.clear();
+  for (const auto& size : sizes) {
+    auto& lattice = lattices_[size_key(size)];
+    if (!lattice) {
+      auto new_lattice = std::make_shared<Lattice>();
+      new_lattice->construct(id, size, bc, order);
+      lattice = new_lattice;
+    }
+  }
+  // all combinations
+  points_.clear();
+  for (const auto& size : sizes) {
+    for (const auto& x : dopings) {
+      for (const auto& v : vparams) {
+        for (const auto& seed : seeds) {
+          points_.push_back(sweep_point{static_cast<int>(points_.size()), size, x, v, seed});
+        }
+      }
+    }
+  }
+  std::stable_sort(points_.begin(), points_.end(), 
+    [](const sweep_point& p, const sweep_point& q) 
+    { return p.size.L1()*p.size.L2()*p.size.L3() > q.size.L1()*q.size.L2()*q.size.L3(); });
+}
+
+const Lattice& ParamSweep::lattice(const lattice_size& size) const
+{
+  auto it = lattices_.find(size_key(size));
+  if (it == lattices_.end()) throw std::range_error("ParamSweep::lattice: no such lattice");
+  return *it->second;
+}
@@ -0,0 +1,53 @@
+// File: sweep.h
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <vector>
+#include <map>
+#include <memory>
+#include "lattice.h"
+
+// one point of a parameter sweep
+struct sweep_point
+{
+  int id;
+  lattice_size size;
+  double hole_doping;
+  RealVector vparams;
+  unsigned seed;
+};
+
+/*---------------------------------------------------------------------------
+* Sweep specification: the points are all combinations of the given lattice
+* sizes, dopings, variational parameters & seeds. A list left empty takes
+* the single default (4x4, zero doping, all vparams 1, seed 1). The lattices
+* are built once per size and shared (read-only) by all points.
+*----------------------------------------------------------------------------*/
+class ParamSweep
+{
+public:
+  ParamSweep() {}
+  ~ParamSweep() {}
+  void add_size(const lattice_size& size) { sizes_.push_back(size); }
+  void add_hole_doping(const double& x) { dopings_.push_back(x); }
+  void add_vparams(const RealVector& vparams) { vparams_.push_back(vparams); }
+  void add_seed(const unsigned& seed) { seeds_.push_back(seed); }
+  // the points, the largest lattices first (for a better load balance)
+  void make_points(const lattice_id& id, const lattice_bc& bc, const int& num_vparams, 
+    const site_order& order=site_order::ROW_MAJOR);
+  int num_points(void) const { return points_.size(); }
+  const sweep_point& point(const int& i) const { return points_[i]; }
+  const Lattice& lattice(const lattice_size& size) const;
+private:
+  std::vector<lattice_size> sizes_;
+  std::vector<double> dopings_;
+  std::vector<RealVector> vparams_;
+  std::vector<unsigned> seeds_;
+  std::vector<sweep_point> points_;
+  std::map<std::vector<int>, std::shared_ptr<const Lattice> > lattices_;
+  static std::vector<int> size_key(const lattice_size& size)
+    { return {size.L1(), size.L2(), size.L3()}; }
+};
+
+
+#endif
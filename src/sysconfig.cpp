@@ -8,13 +8,26 @@
 #include <iomanip>
 #include "sysconfig.h"
 
-void SysConfig::init(const lattice_id& lid, const lattice_size& size, const wf_id& wid)
+void SysConfig::init(const lattice_id& lid, const lattice_size& size, const wf_id& wid,
+  const site_order& order, const Vector3d& twist)
+{
+  lattice_.construct(lid,size,order);
+  if (!twist.isZero(0.0)) lattice_.set_twist(twist);
+  setup(wid, 0.0);
+}
+
+void SysConfig::init(const Lattice& lattice, const wf_id& wid, const double& hole_doping)
+{
+  lattice_ = lattice;
+  setup(wid, hole_doping);
+}
+
+void SysConfig::setup(const wf_id& wid, const double& hole_doping)
 {
-  lattice_.construct(lid,size);
   // one body part of the wavefunction
   num_sites_ = lattice_.num_sites();
   basis_state_.init(num_sites_);
-  hole_doping_ = 0.0;
+  hole_doping_ = hole_doping;
   wf_.init(wid, lattice_, hole_doping_);
   num_upspins_ = wf_.num_upspins();
   num_dnspins_ = wf_.num_dnspins();
@@ -31,10 +44,14 @@ void SysConfig::init(const lattice_id& lid, const lattice_size& size, const wf_i
   psi_row_.resize(num_dnspins_);
   psi_col_.resize(num_upspins_);
   inv_row_.resize(num_upspins_);
+  inv_col_.resize(num_upspins_);
+  inv_pivot_.resize(num_upspins_);
+  site_sz_.resize(num_sites_);
 }
 
 int SysConfig::build(const RealVector& vparams)
 {
+  TRACE_SCOPE("build");
   wf_.compute(lattice_, vparams, 0);
   return 0;
 }
@@ -87,7 +104,7 @@ int SysConfig::init_state(void)
   */
 
   //std::cout << psi_mat_ << "\n"; getchar();
-  psi_inv_ = psi_mat_.inverse();
+  refresh_inverse();
   // reset run parameters
   num_updates_ = 0;
   refresh_cycle_ = 100;
@@ -98,12 +115,13 @@ int SysConfig::init_state(void)
 
 int SysConfig::update_state(void)
 {
+  TRACE_SCOPE("sweep");
   for (int n=0; n<num_upspins_; ++n) do_upspin_hop();
   for (int n=0; n<num_dnspins_; ++n) do_dnspin_hop();
   //for (int n=0; n<num_exchange_moves_; ++n) do_spin_exchange();
   num_updates_++;
   if (num_updates_ % refresh_cycle_ == 0) {
-    psi_inv_ = psi_mat_.inverse();
+    refresh_inverse();
   }
   //std::cout << basis_state_ << "\n"; getchar();
   return 0;
@@ -111,13 +129,27 @@ int SysConfig::update_state(void)
 
 int SysConfig::do_upspin_hop(void)
 {
-  if (basis_state_.gen_upspin_hop()) {
+  bool have_move;
+  {
+    INSTRUMENT_PHASE(profile_, PROPOSE);
+    have_move = basis_state_.gen_upspin_hop();
+  }
+  if (have_move) {
+    INSTRUMENT_COUNT(profile_, UPSPIN_HOP, PROPOSED);
     int upspin = basis_state_.which_upspin();
     int to_site = basis_state_.which_site();
-    wf_.get_amplitudes(psi_row_, to_site, basis_state_.dnspin_sites());
-    amplitude_t det_ratio = psi_row_.cwiseProduct(psi_inv_.col(upspin)).sum();
+    {
+      INSTRUMENT_PHASE(profile_, GATHER);
+      wf_.get_amplitudes(psi_row_, to_site, basis_state_.dnspin_sites());
+    }
+    amplitude_t det_ratio;
+    {
+      INSTRUMENT_PHASE(profile_, RATIO);
+      det_ratio = psi_row_.cwiseProduct(psi_inv_.col(upspin)).sum();
+    }
     if (std::abs(det_ratio) < 1.0E-12) {
       // for safety
+      INSTRUMENT_COUNT(profile_, UPSPIN_HOP, NODAL_REJECTED);
       basis_state_.undo_last_move();
       return 0; 
     } 
@@ -126,9 +158,11 @@ int SysConfig::do_upspin_hop(void)
     num_proposed_moves_++;
     if (basis_state_.rng().random_real()<transition_proby) {
       num_accepted_moves_++;
+      INSTRUMENT_COUNT(profile_, UPSPIN_HOP, ACCEPTED);
       // upddate state
       basis_state_.commit_last_move();
       // update amplitudes
+      INSTRUMENT_PHASE(profile_, INV_UPDATE);
       inv_update_upspin(upspin,psi_row_,det_ratio);
     }
     else {
@@ -140,12 +174,26 @@ int SysConfig::do_upspin_hop(void)
 
 int SysConfig::do_dnspin_hop(void)
 {
-  if (basis_state_.gen_dnspin_hop()) {
+  bool have_move;
+  {
+    INSTRUMENT_PHASE(profile_, PROPOSE);
+    have_move = basis_state_.gen_dnspin_hop();
+  }
+  if (have_move) {
+    INSTRUMENT_COUNT(profile_, DNSPIN_HOP, PROPOSED);
     int dnspin = basis_state_.which_dnspin();
     int to_site = basis_state_.which_site();
-    wf_.get_amplitudes(psi_col_, basis_state_.upspin_sites(), to_site);
-    amplitude_t det_ratio = psi_col_.cwiseProduct(psi_inv_.row(dnspin)).sum();
+    {
+      INSTRUMENT_PHASE(profile_, GATHER);
+      wf_.get_amplitudes(psi_col_, basis_state_.upspin_sites(), to_site);
+    }
+    amplitude_t det_ratio;
+    {
+      INSTRUMENT_PHASE(profile_, RATIO);
+      det_ratio = psi_col_.cwiseProduct(psi_inv_.row(dnspin)).sum();
+    }
     if (std::abs(det_ratio) < 1.0E-12) { // for safety
+      INSTRUMENT_COUNT(profile_, DNSPIN_HOP, NODAL_REJECTED);
       basis_state_.undo_last_move();
       return 0; 
     } 
@@ -154,9 +202,11 @@ int SysConfig::do_dnspin_hop(void)
     num_proposed_moves_++;
     if (basis_state_.rng().random_real()<transition_proby) {
       num_accepted_moves_++;
+      INSTRUMENT_COUNT(profile_, DNSPIN_HOP, ACCEPTED);
       // upddate state
       basis_state_.commit_last_move();
       // update amplitudes
+      INSTRUMENT_PHASE(profile_, INV_UPDATE);
       inv_update_dnspin(dnspin,psi_col_,det_ratio);
     }
     else {
@@ -166,6 +216,47 @@ int SysConfig::do_dnspin_hop(void)
   return 0;
 }
 
+void SysConfig::refresh_inverse(void)
+{
+  INSTRUMENT_PHASE(profile_, REFRESH);
+  TRACE_SCOPE("refresh");
+  if (!gauss_jordan_inverse(psi_mat_, psi_inv_, inv_col_, inv_row_, inv_pivot_))
+    throw std::underflow_error("*SysConfig::refresh_inverse: singular amplitude matrix");
+}
+
+bool SysConfig::gauss_jordan_inverse(const ComplexMatrix& mat, ComplexMatrix& inv,
+  ColVector& work_col, RowVector& work_row, ivector& pivots)
+{
+  /* In-place Gauss-Jordan inversion with partial (row) pivoting. Unlike 
+    'inverse()', which needs scratch space for the blocked LU, this only 
+    uses the preallocated work arrays. */
+  int n = mat.rows();
+  inv = mat;
+  for (int k=0; k<n; ++k) {
+    int p;
+    inv.col(k).tail(n-k).cwiseAbs2().maxCoeff(&p);
+    p += k;
+    pivots(k) = p;
+    if (p != k) inv.row(k).swap(inv.row(p));
+    amplitude_t pivot = inv(k,k);
+    if (std::abs(pivot) == 0.0) return false;
+    amplitude_t pivot_inv = amplitude_t(1.0)/pivot;
+    work_col = inv.col(k);
+    work_col(k) = 0.0;
+    inv(k,k) = 1.0;
+    inv.row(k) *= pivot_inv;
+    work_row = inv.row(k);
+    inv.col(k).setZero();
+    inv.noalias() -= work_col * work_row;
+    inv.row(k) = work_row;
+  }
+  // undo the row interchanges as column interchanges
+  for (int k=n-1; k>=0; --k) {
+    if (pivots(k) != k) inv.col(k).swap(inv.col(pivots(k)));
+  }
+  return true;
+}
+
 int SysConfig::inv_update_upspin(const int& upspin, const ColVector& psi_row, 
   const amplitude_t& det_ratio)
 {
@@ -189,11 +280,11 @@ int SysConfig::inv_update_dnspin(const int& dnspin, const RowVector& psi_col,
   psi_mat_.col(dnspin) = psi_col;
   amplitude_t ratio_inv = amplitude_t(1.0)/det_ratio;
   for (int i=0; i<dnspin; ++i) {
-    amplitude_t beta = ratio_inv*psi_col_.cwiseProduct(psi_inv_.row(i)).sum();
+    amplitude_t beta = ratio_inv*psi_col.cwiseProduct(psi_inv_.row(i)).sum();
     psi_inv_.row(i) -= beta * psi_inv_.row(dnspin);
   }
   for (int i=dnspin+1; i<num_dnspins_; ++i) {
-    amplitude_t beta = ratio_inv*psi_col_.cwiseProduct(psi_inv_.row(i)).sum();
+    amplitude_t beta = ratio_inv*psi_col.cwiseProduct(psi_inv_.row(i)).sum();
     psi_inv_.row(i) -= beta * psi_inv_.row(dnspin);
   }
   psi_inv_.row(dnspin) *= ratio_inv;
@@ -214,32 +305,100 @@ void SysConfig::print_stats(std::ostream& os) const
 }
 
 double SysConfig::get_energy(void) const
+{
+  return local_energy(basis_state_, psi_inv_, psi_row_, psi_col_);
+}
+
+void SysConfig::take_snapshot(config_snapshot& snapshot) const
+{
+  // sizes are unchanged after the first copy, so no reallocation
+  snapshot.basis_state = basis_state_;
+  snapshot.psi_inv = psi_inv_;
+  snapshot.psi_row.resize(num_dnspins_);
+  snapshot.psi_col.resize(num_upspins_);
+  snapshot.site_sz.resize(num_sites_);
+  snapshot.sz_corr.resize(lattice_.num_disp_classes());
+}
+
+double SysConfig::get_energy(config_snapshot& snapshot) const
+{
+  return local_energy(snapshot.basis_state, snapshot.psi_inv, snapshot.psi_row,
+    snapshot.psi_col);
+}
+
+bool SysConfig::load_snapshot(const ivector& state, config_snapshot& snapshot) const
+{
+  // sizes the buffers on first use
+  if (snapshot.psi_mat.rows() != num_upspins_) {
+    take_snapshot(snapshot);
+    snapshot.psi_mat.resize(num_upspins_,num_dnspins_);
+    snapshot.inv_col.resize(num_upspins_);
+    snapshot.inv_row.resize(num_upspins_);
+    snapshot.inv_pivot.resize(num_upspins_);
+  }
+  snapshot.basis_state.set_state(state);
+  wf_.get_amplitudes(snapshot.psi_mat, snapshot.basis_state.upspin_sites(), 
+    snapshot.basis_state.dnspin_sites());
+  return gauss_jordan_inverse(snapshot.psi_mat, snapshot.psi_inv, snapshot.inv_col, 
+    snapshot.inv_row, snapshot.inv_pivot);
+}
+
+void SysConfig::get_sz_correlation(RealVector& corr) const
+{
+  sz_correlation(basis_state_, site_sz_, corr);
+}
+
+void SysConfig::sz_correlation(const FockBasis& basis_state, RealVector& site_sz, 
+  RealVector& corr) const
+{
+  for (int i=0; i<num_sites_; ++i) {
+    site_sz(i) = 0.5*(basis_state.op_ni_up(i)-basis_state.op_ni_dn(i));
+  }
+  corr.setZero();
+  for (int i=0; i<num_sites_; ++i) {
+    if (site_sz(i) == 0.0) continue;
+    for (int j=0; j<num_sites_; ++j) {
+      corr(lattice_.disp_class(i,j)) += site_sz(i)*site_sz(j);
+    }
+  }
+  for (int c=0; c<corr.size(); ++c) corr(c) /= lattice_.class_multiplicity(c);
+}
+
+double SysConfig::local_energy(const FockBasis& basis_state, const ComplexMatrix& psi_inv,
+  ColVector& psi_row, RowVector& psi_col) const
 {
   // hopping energy
   double bond_sum = 0.0;
+  op_move mv;
+  const int* bond_src = lattice_.bond_src().data();
+  const int* bond_tgt = lattice_.bond_tgt().data();
+  const int* bond_phase = lattice_.bond_phase().data();
+  // twist factors for src->tgt hops of UP spins (none without a twist)
+  const amplitude_t* bond_twist = lattice_.has_twist() ? lattice_.bond_twist().data() : nullptr;
   for (int i=0; i<lattice_.num_bonds(); ++i) {
-    int src = lattice_.bond(i).src();
-    int tgt = lattice_.bond(i).tgt();
-    int phase = lattice_.bond(i).phase();
+    int src = bond_src[i];
+    int tgt = bond_tgt[i];
+    int phase = bond_phase[i];
     // upspin hop
-    if (basis_state_.op_cdagc_up(src,tgt)) {
-      int upspin = basis_state_.which_upspin();
-      int to_site = basis_state_.which_site();
-      wf_.get_amplitudes(psi_row_,to_site,basis_state_.dnspin_sites());
-      amplitude_t det_ratio = psi_row_.cwiseProduct(psi_inv_.col(upspin)).sum();
+    if (basis_state.op_cdagc_up(src,tgt,mv)) {
+      wf_.get_amplitudes(psi_row,mv.to_site,basis_state.dnspin_sites());
+      amplitude_t det_ratio = psi_row.cwiseProduct(psi_inv.col(mv.spin)).sum();
+      if (bond_twist) {
+        det_ratio *= (mv.fr_site==src) ? bond_twist[i] : std::conj(bond_twist[i]);
+      }
       bond_sum += std::real(det_ratio)*phase;
     }
     // dnspin hop
-    if (basis_state_.op_cdagc_dn(src,tgt)) {
-      int dnspin = basis_state_.which_dnspin();
-      int to_site = basis_state_.which_site();
-      wf_.get_amplitudes(psi_col_,basis_state_.upspin_sites(),to_site);
-      amplitude_t det_ratio = psi_col_.cwiseProduct(psi_inv_.row(dnspin)).sum();
+    if (basis_state.op_cdagc_dn(src,tgt,mv)) {
+      wf_.get_amplitudes(psi_col,basis_state.upspin_sites(),mv.to_site);
+      amplitude_t det_ratio = psi_col.cwiseProduct(psi_inv.row(mv.spin)).sum();
+      if (bond_twist) {
+        det_ratio *= (mv.fr_site==src) ? std::conj(bond_twist[i]) : bond_twist[i];
+      }
       bond_sum += std::real(det_ratio)*phase;
     }
   }
 
   double t=1.0;
   return -t*bond_sum/num_sites_;
-}
-
+}
\ No newline at end of file
@@ -11,23 +11,69 @@
 #include "lattice.h"
 #include "wavefunction.h"
 #include "basis.h"
+#include "instrument.h"
+#include "trace.h"
 
 using amplitude_t = std::complex<double>;
 
+// copy of the sampled configuration, enough to make measurements on it
+struct config_snapshot
+{
+  FockBasis basis_state;
+  ComplexMatrix psi_inv;
+  // work arrays
+  ColVector psi_row;
+  RowVector psi_col;
+  // for rebuilding 'psi_inv' from the basis state only (see 'load_snapshot')
+  ComplexMatrix psi_mat;
+  ColVector inv_col;
+  RowVector inv_row;
+  ivector inv_pivot;
+  // spin correlation
+  RealVector site_sz;
+  RealVector sz_corr;
+};
+
 class SysConfig
 {
 public:
 	SysConfig() {}
-	SysConfig(const lattice_id& lid, const lattice_size& size, const wf_id& wid) 
-		{ init(lid, size, wid); }
+	SysConfig(const lattice_id& lid, const lattice_size& size, const wf_id& wid,
+		const site_order& order=site_order::ROW_MAJOR, const Vector3d& twist=Vector3d(0,0,0)) 
+		{ init(lid, size, wid, order, twist); }
 	~SysConfig() {}
-	void init(const lattice_id& id, const lattice_size& size, const wf_id& wid);
+	void init(const lattice_id& id, const lattice_size& size, const wf_id& wid,
+		const site_order& order=site_order::ROW_MAJOR, const Vector3d& twist=Vector3d(0,0,0));
+	// on a copy of an already built lattice
+	void init(const Lattice& lattice, const wf_id& wid, const double& hole_doping=0.0);
+	// independent Markov chains (e.g. one per twist) need distinct seeds
+	void seed(const unsigned& seed) { basis_state_.rng().std::mt19937_64::seed(seed); }
+	void set_table_mode(const table_mode& mode, const std::string& dir="")
+		{ wf_.set_table_mode(mode, dir); }
+	void set_table_memo(const int& capacity) { wf_.set_memo(capacity); }
 	int build(const RealVector& vparams);
 	int init_state(void);
 	int update_state(void);
 	const int& num_vparams(void) const { return num_total_vparams_; }
+	const Lattice& lattice(void) const { return lattice_; }
   void print_stats(std::ostream& os=std::cout) const;
   double get_energy(void) const;
+  // measurements on a snapshot (thread-safe w.r.t. the sampling)
+  void take_snapshot(config_snapshot& snapshot) const;
+  double get_energy(config_snapshot& snapshot) const;
+  // snapshot of a given (e.g. archived) state, false if its amplitude matrix is singular
+  bool load_snapshot(const ivector& state, config_snapshot& snapshot) const;
+  const FockBasis& basis_state(void) const { return basis_state_; }
+  // microbenchmarks of the kernels (bench_main.cpp)
+  friend class KernelBench;
+  // <S^z_i S^z_j> averaged over each class of symmetry equivalent pairs 
+  // (see 'Lattice::disp_class'), one value per class
+  void get_sz_correlation(RealVector& corr) const;
+  void get_sz_correlation(config_snapshot& snapshot) const
+    { sz_correlation(snapshot.basis_state, snapshot.site_sz, snapshot.sz_corr); }
+  // phase times & move counts of the sampling (VMC_INSTRUMENT builds)
+  instrument::Profile& profile(void) { return profile_; }
+  const instrument::Profile& profile(void) const { return profile_; }
 private:
 	Lattice lattice_;
     FockBasis basis_state_;
@@ -43,16 +89,20 @@ private:
 	int num_wf_params_;
 	RealVector vparams_;
 
-	// work arrays
+	// work arrays (sized in 'init', no allocation while sampling)
   mutable ColVector psi_row_;
   mutable RowVector psi_col_;
   mutable RowVector inv_row_;
+  ColVector inv_col_;
+  ivector inv_pivot_;
+  mutable RealVector site_sz_;
 
 	// update parameters_
   int num_updates_;
   int refresh_cycle_;
   int num_proposed_moves_;
   int num_accepted_moves_;
+  instrument::Profile profile_;
 
   int do_upspin_hop(void);
   int do_dnspin_hop(void);
@@ -60,6 +110,14 @@ private:
     const std::complex<double>& det_ratio);
   int inv_update_dnspin(const int& dnspin, const RowVector& psi_col, 
     const std::complex<double>& det_ratio);
+  void setup(const wf_id& wid, const double& hole_doping);
+  void refresh_inverse(void);
+  static bool gauss_jordan_inverse(const ComplexMatrix& mat, ComplexMatrix& inv,
+    ColVector& work_col, RowVector& work_row, ivector& pivots);
+  double local_energy(const FockBasis& basis_state, const ComplexMatrix& psi_inv,
+    ColVector& psi_row, RowVector& psi_col) const;
+  void sz_correlation(const FockBasis& basis_state, RealVector& site_sz, 
+    RealVector& corr) const;
 };
 
 
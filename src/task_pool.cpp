@@ -0,0 +1,88 @@
+// File: task_pool.cpp
+#include <stdexcept>
+#include <thread>
+#include "task_pool.h"
+#include "trace.h"
+
+TaskPool::TaskPool(const int& num_threads)
+{
+  if (num_threads<1) throw std::invalid_argument("TaskPool::TaskPool: invalid thread number");
+  for (int i=0; i<num_threads; ++i) queues_.push_back(std::unique_ptr<work_queue>(new work_queue));
+}
+
+void TaskPool::submit(const task& t)
+{
+  int id = next_queue_++ % num_threads();
+  num_pending_++;
+  {
+    std::lock_guard<std::mutex> lock(queues_[id]->mtx);
+    queues_[id]->tasks.push_back(t);
+    num_queued_++;
+  }
+  std::lock_guard<std::mutex> lock(idle_mtx_);
+  idle_.notify_one();
+}
+
+bool TaskPool::pop(const int& id, task& t)
+{
+  std::lock_guard<std::mutex> lock(queues_[id]->mtx);
+  if (queues_[id]->tasks.empty()) return false;
+  t = std::move(queues_[id]->tasks.front());
+  queues_[id]->tasks.pop_front();
+  num_queued_--;
+  return true;
+}
+
+bool TaskPool::steal(const int& id, task& t)
+{
+  for (int k=1; k<num_threads(); ++k) {
+    work_queue& victim = *queues_[(id+k)%num_threads()];
+    std::lock_guard<std::mutex> lock(victim.mtx);
+    if (victim.tasks.empty()) continue;
+    t = std::move(victim.tasks.back());
+    victim.tasks.pop_back();
+    num_queued_--;
+    num_steals_++;
+    return true;
+  }
+  return false;
+}
+
+void TaskPool::work(const int& id, std::exception_ptr& error)
+{
+  if (id > 0) trace::set_thread_name("pool worker", id);
+  task t;
+  // a task in progress may still submit more, so wait for 'num_pending_'
+  while (num_pending_ > 0) {
+    if (pop(id,t) || steal(id,t)) {
+      // after a failure, the remaining tasks are dropped
+      if (!failed_) {
+        try { t(); }
+        catch (...) { error = std::current_exception(); failed_ = true; }
+      }
+      // the last one wakes up all the idle workers to leave
+      if (--num_pending_ == 0) {
+        std::lock_guard<std::mutex> lock(idle_mtx_);
+        idle_.notify_all();
+      }
+    }
+    else {
+      // sleep until a task is submitted or all are done
+      std::unique_lock<std::mutex> lock(idle_mtx_);
+      idle_.wait(lock, [this](void) { return num_queued_>0 || num_pending_==0; });
+    }
+  }
+}
+
+void TaskPool::run(void)
+{
+  failed_ = false;
+  std::vector<std::exception_ptr> errors(num_threads());
+  std::vector<std::thread> workers;
+  for (int id=1; id<num_threads(); ++id) {
+    workers.push_back(std::thread(&TaskPool::work, this, id, std::ref(errors[id])));
+  }
+  work(0, errors[0]);
+  for (auto& w : workers) w.join();
+  for (auto& e : errors) if (e) std::rethrow_exception(e);
+}
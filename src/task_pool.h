@@ -0,0 +1,53 @@
+// File: task_pool.h
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <functional>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+
+/*---------------------------------------------------------------------------
+* Work-stealing thread pool for independent tasks. Tasks are dealt out to 
+* the workers' queues round-robin (submit the expensive ones first). A worker
+* takes its tasks from the front of its own queue, in submission order; once 
+* it is empty it steals from the back of the others', i.e. the tasks their 
+* owners would reach last.
+* Tasks may submit further tasks while 'run' is in progress. Idle workers
+* sleep until a task is submitted or the last one is done.
+*----------------------------------------------------------------------------*/
+class TaskPool
+{
+public:
+  using task = std::function<void(void)>;
+  TaskPool(const int& num_threads=1);
+  ~TaskPool() {}
+  int num_threads(void) const { return queues_.size(); }
+  void submit(const task& t);
+  // runs until all tasks are done, the first exception is rethrown
+  void run(void);
+  long num_steals(void) const { return num_steals_; }
+private:
+  struct work_queue 
+  {
+    std::mutex mtx;
+    std::deque<task> tasks;
+  };
+  std::vector<std::unique_ptr<work_queue> > queues_;
+  std::atomic<int> next_queue_{0};
+  std::atomic<long> num_pending_{0};
+  std::atomic<long> num_queued_{0};
+  std::mutex idle_mtx_;
+  std::condition_variable idle_;
+  std::atomic<long> num_steals_{0};
+  std::atomic<bool> failed_{false};
+  bool pop(const int& id, task& t);
+  bool steal(const int& id, task& t);
+  void work(const int& id, std::exception_ptr& error);
+};
+
+
+#endif
@@ -0,0 +1,144 @@
+// File: trace.cpp
+#include <chrono>
+#include <algorithm>
+#include <vector>
+#include <fstream>
+#include <iomanip>
+#include "trace.h"
+
+namespace trace {
+
+namespace {
+
+using clock = std::chrono::steady_clock;
+
+struct event_t
+{
+  const char* name;
+  std::int64_t begin;
+  std::int64_t end;
+};
+
+// written by its own thread only
+struct thread_ring
+{
+  std::vector<event_t> events;
+  std::atomic<std::uint64_t> count{0};
+  std::string name;
+};
+
+const int max_threads = 256;
+std::atomic<thread_ring*> rings[max_threads];
+std::atomic<int> num_rings{0};
+// a new session makes the threads take new rings
+std::atomic<unsigned> session{0};
+unsigned capacity_mask = 0;
+clock::time_point origin;
+
+thread_local thread_ring* local_ring = nullptr;
+thread_local unsigned local_session = 0;
+
+thread_ring* this_ring(void)
+{
+  unsigned s = session.load(std::memory_order_acquire);
+  if (local_session != s) {
+    local_session = s;
+    local_ring = nullptr;
+    int id = num_rings.fetch_add(1);
+    // beyond 'max_threads' a thread is not traced
+    if (id < max_threads) {
+      thread_ring* ring = new thread_ring;
+      ring->events.resize(capacity_mask+1);
+      rings[id].store(ring, std::memory_order_release);
+      local_ring = ring;
+    }
+  }
+  return local_ring;
+}
+
+} // end anonymous namespace
+
+namespace detail {
+
+std::atomic<bool> enabled_{false};
+
+std::int64_t now(void)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now()-origin).count();
+}
+
+void record(const char* name, const std::int64_t& begin, const std::int64_t& end)
+{
+  thread_ring* ring = this_ring();
+  if (!ring) return;
+  std::uint64_t n = ring->count.load(std::memory_order_relaxed);
+  ring->events[n & capacity_mask] = event_t{name, begin, end};
+  ring->count.store(n+1, std::memory_order_release);
+}
+
+} // end namespace detail
+
+void start(const unsigned& capacity)
+{
+  // no traced thread may be running here
+  detail::enabled_.store(false);
+  int n = std::min(num_rings.load(), max_threads);
+  for (int i=0; i<n; ++i) delete rings[i].exchange(nullptr);
+  num_rings.store(0);
+  unsigned size = 1;
+  while (size < capacity) size *= 2;
+  capacity_mask = size-1;
+  origin = clock::now();
+  session.fetch_add(1, std::memory_order_release);
+  detail::enabled_.store(true);
+}
+
+void stop(void)
+{
+  detail::enabled_.store(false);
+}
+
+void set_thread_name(const char* name, const int& id)
+{
+  if (!enabled()) return;
+  thread_ring* ring = this_ring();
+  if (!ring) return;
+  ring->name = name;
+  if (id >= 0) ring->name += " "+std::to_string(id);
+}
+
+bool write(const std::string& fname)
+{
+  std::ofstream fs(fname);
+  fs << "{\"traceEvents\":[\n";
+  std::uint64_t num_dropped = 0;
+  bool first = true;
+  auto separator = [&](void) { if (!first) fs << ",\n"; first = false; };
+  fs << std::fixed << std::setprecision(3);
+  int n = std::min(num_rings.load(), max_threads);
+  for (int tid=0; tid<n; ++tid) {
+    const thread_ring* ring = rings[tid].load(std::memory_order_acquire);
+    if (!ring) continue;
+    separator();
+    fs << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+       << ",\"args\":{\"name\":\""
+       << (ring->name.empty() ? "thread "+std::to_string(tid) : ring->name) << "\"}}";
+    // the oldest events are gone if the ring went round
+    std::uint64_t count = ring->count.load(std::memory_order_acquire);
+    std::uint64_t size = capacity_mask+1;
+    std::uint64_t begin = count>size ? count-size : 0;
+    num_dropped += begin;
+    for (std::uint64_t i=begin; i<count; ++i) {
+      const event_t& e = ring->events[i & capacity_mask];
+      separator();
+      fs << "{\"name\":\"" << e.name << "\",\"cat\":\"vmc\",\"ph\":\"X\",\"ts\":"
+         << 1.0E-3*e.begin << ",\"dur\":" << 1.0E-3*(e.end-e.begin)
+         << ",\"pid\":1,\"tid\":" << tid << "}";
+    }
+  }
+  fs << "\n],\n\"displayTimeUnit\":\"ns\",\n\"otherData\":{\"dropped_events\":"
+     << num_dropped << "}}\n";
+  return static_cast<bool>(fs);
+}
+
+} // end namespace trace
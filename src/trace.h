@@ -0,0 +1,56 @@
+// File: trace.h
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/*---------------------------------------------------------------------------
+* Timeline of a (multi-threaded) run in the Chrome trace format, for
+* chrome://tracing or Perfetto. Between 'start' and 'stop' every
+*   TRACE_SCOPE("sweep");
+* records a complete event (begin & duration) when the scope ends. Each
+* thread writes into its own ring of 'capacity' events, the oldest events
+* being overwritten, with no locking; a thread takes its ring on its first
+* event or 'set_thread_name' (the only allocation, name it before any 
+* allocation-free section). When tracing is off a scope costs one
+* relaxed atomic load. 'write' is meant to be called once the traced
+* threads have finished.
+*----------------------------------------------------------------------------*/
+namespace trace {
+
+void start(const unsigned& capacity=65536);
+void stop(void);
+bool write(const std::string& fname);
+// shown in the viewer instead of the thread number
+void set_thread_name(const char* name, const int& id=-1);
+
+namespace detail {
+extern std::atomic<bool> enabled_;
+std::int64_t now(void);
+void record(const char* name, const std::int64_t& begin, const std::int64_t& end);
+}
+
+inline bool enabled(void) { return detail::enabled_.load(std::memory_order_relaxed); }
+
+class Scope
+{
+public:
+  explicit Scope(const char* name) : name_(enabled() ? name : nullptr)
+    { if (name_) begin_ = detail::now(); }
+  ~Scope() { if (name_) detail::record(name_, begin_, detail::now()); }
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+private:
+  const char* name_;
+  std::int64_t begin_{0};
+};
+
+} // end namespace trace
+
+#define TRACE_CONCAT_(a,b) a##b
+#define TRACE_CONCAT(a,b) TRACE_CONCAT_(a,b)
+#define TRACE_SCOPE(name) trace::Scope TRACE_CONCAT(trace_scope_,__LINE__)(name)
+
+#endif
@@ -0,0 +1,107 @@
+// File: twist_average.cpp
+#include <cmath>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <exception>
+#include "constants.h"
+#include "twist_average.h"
+#include "trace.h"
+
+void TwistAverage::init(const Lattice& lattice, const twist_set& type, const int& n, 
+  const unsigned& seed)
+{
+  if (n<1) throw std::invalid_argument("TwistAverage::init: invalid number of twists");
+  type_ = type;
+  // axes that can be twisted
+  const int L[3] = {lattice.size_L1(), lattice.size_L2(), lattice.size_L3()};
+  const bc_t bc[3] = {lattice.bc_L1(), lattice.bc_L2(), lattice.bc_L3()};
+  std::vector<int> axes;
+  for (int d=0; d<3; ++d) if (L[d]>1 && bc[d]!=bc_t::OPEN) axes.push_back(d);
+  if (axes.empty()) throw std::invalid_argument("TwistAverage::init: no periodic axis");
+
+  twists_.clear();
+  if (type_==twist_set::GRID) {
+    int num_twists = 1;
+    for (unsigned a=0; a<axes.size(); ++a) num_twists *= n;
+    for (int t=0; t<num_twists; ++t) {
+      Vector3d twist(0,0,0);
+      int j = t;
+      for (unsigned a=0; a<axes.size(); ++a) {
+        twist(axes[a]) = TWO_PI*(j%n+0.5)/n - PI;
+        j /= n;
+      }
+      twists_.push_back(twist);
+    }
+  }
+  else {
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> angle(-PI, PI);
+    for (int t=0; t<n; ++t) {
+      Vector3d twist(0,0,0);
+      for (unsigned a=0; a<axes.size(); ++a) twist(axes[a]) = angle(rng);
+      twists_.push_back(twist);
+    }
+  }
+  results_.assign(twists_.size(), twist_result());
+}
+
+void TwistAverage::run(const int& num_threads, const run_func& func)
+{
+  if (num_threads<1) 
+    throw std::invalid_argument("TwistAverage::run: invalid thread number");
+  // threads take the next twist as they get free; after a failure the
+  // remaining twists are dropped and the first exception is rethrown
+  std::atomic<int> next(0);
+  std::atomic<bool> failed(false);
+  std::vector<std::exception_ptr> errors(std::max(std::min(num_threads,num_twists()),1));
+  auto work = [&](const int& id) 
+  {
+    int t;
+    while (!failed && (t=next++) < num_twists()) {
+      try { func(t, twists_[t], results_[t]); }
+      catch (...) { errors[id] = std::current_exception(); failed = true; }
+    }
+  };
+  std::vector<std::thread> workers;
+  for (int id=1; id<std::min(num_threads,num_twists()); ++id) {
+    workers.push_back(std::thread([&work,id](void) 
+      { trace::set_thread_name("twist worker", id); work(id); }));
+  }
+  work(0);
+  for (auto& w : workers) w.join();
+  for (auto& e : errors) if (e) std::rethrow_exception(e);
+}
+
+double TwistAverage::mean(void) const
+{
+  double sum = 0.0;
+  for (const auto& r : results_) sum += r.mean;
+  return sum/results_.size();
+}
+
+double TwistAverage::stddev(void) const
+{
+  // independent runs: the variances add
+  double var = 0.0;
+  for (const auto& r : results_) var += r.stddev*r.stddev;
+  return std::sqrt(var)/results_.size();
+}
+
+double TwistAverage::spread(void) const
+{
+  int n = results_.size();
+  if (n<2) return -1.0;
+  double m = mean();
+  double var = 0.0;
+  for (const auto& r : results_) var += (r.mean-m)*(r.mean-m);
+  return std::sqrt(var/(n*(n-1.0)));
+}
+
+unsigned TwistAverage::num_samples(void) const
+{
+  unsigned n = 0;
+  for (const auto& r : results_) n += r.num_samples;
+  return n;
+}
@@ -0,0 +1,59 @@
+// File: twist_average.h
+#ifndef TWIST_AVERAGE_H
+#define TWIST_AVERAGE_H
+
+#include <functional>
+#include <vector>
+#include "lattice.h"
+
+/* Set of boundary twists:
+*   GRID: n points per (twistable) axis, offset from the zone center, 
+*     theta = 2pi*(j+1/2)/n - pi, j=0..n-1
+*   RANDOM: n twists uniformly distributed in [-pi,pi) per axis
+*/
+enum class twist_set {GRID, RANDOM};
+
+// result of the run at one twist
+struct twist_result
+{
+  double mean{0.0};
+  double stddev{0.0};
+  unsigned num_samples{0};
+};
+
+/*---------------------------------------------------------------------------
+* Twist averaged boundary conditions. Every twist is an independent run 
+* (own k-points, wavefunction & Markov chain); 'num_threads' twists are run
+* at a time, and an exception in any of them is rethrown by 'run' once all
+* threads are done. RANDOM twists are drawn with the given seed. The twist
+* average is the plain mean of the twist results, its error bar combines 
+* the statistical ones of the single twists. For RANDOM twists the spread 
+* of the results over the twists is also a sampling error.
+*----------------------------------------------------------------------------*/
+class TwistAverage
+{
+public:
+  using run_func = std::function<void(const int& twist_id, const Vector3d& twist, 
+    twist_result& result)>;
+  TwistAverage() {}
+  ~TwistAverage() {}
+  void init(const Lattice& lattice, const twist_set& type, const int& n, 
+    const unsigned& seed=1);
+  void run(const int& num_threads, const run_func& func);
+  int num_twists(void) const { return twists_.size(); }
+  const twist_set& type(void) const { return type_; }
+  const Vector3d& twist(const int& i) const { return twists_[i]; }
+  const twist_result& result(const int& i) const { return results_[i]; }
+  double mean(void) const;
+  double stddev(void) const;
+  // standard error of the mean over the twists (needs 2 twists or more)
+  double spread(void) const;
+  unsigned num_samples(void) const;
+private:
+  twist_set type_{twist_set::GRID};
+  std::vector<Vector3d> twists_;
+  std::vector<twist_result> results_;
+};
+
+
+#endif
@@ -6,64 +6,763 @@
 *----------------------------------------------------------------------------*/
 // File: vmc.cpp
 
+#include <algorithm>
+#include <fstream>
 #include "vmc.h"
 
+namespace {
+// names of the choices in the input
+template<typename T> T parse_choice(const std::string& name, const std::string& value, 
+  const std::vector<std::pair<std::string,T> >& choices)
+{
+  std::string v(value);
+  std::transform(v.begin(), v.end(), v.begin(), ::toupper);
+  for (const auto& c : choices) if (c.first == v) return c.second;
+  std::string names;
+  for (const auto& c : choices) names += " "+c.first;
+  throw std::invalid_argument("VMC::init: '"+name+"' must be one of"+names);
+}
+
+// lattice sizes 'L1xL2[xL3]', comma (or blank) separated
+std::vector<lattice_size> parse_sizes(const std::string& name, const std::string& value)
+{
+  std::string v(value);
+  std::replace(v.begin(), v.end(), ',', ' ');
+  std::istringstream is(v);
+  std::vector<lattice_size> sizes;
+  std::string item;
+  while (is >> item) {
+    std::replace(item.begin(), item.end(), 'x', ' ');
+    std::istringstream dims(item);
+    int L[3] = {1, 1, 1};
+    int n = 0, Ln;
+    while (n<3 && dims >> Ln) L[n++] = Ln;
+    if (n==0 || !dims.eof() || L[0]<1 || L[1]<1 || L[2]<1) 
+      throw std::invalid_argument("VMC::init: '"+name+"' must be a list of sizes 'L1xL2[xL3]'");
+    sizes.push_back(lattice_size(L[0], L[1], L[2]));
+  }
+  return sizes;
+}
+}
+
 int VMC::init(void) 
 {
-  config.init(lattice_id::SQUARE,lattice_size(4,4),wf_id::BCS);
+  return init(input::Parameters());
+}
+
+int VMC::init(const input::Parameters& inputs) 
+{
+  // lattice & wavefunction
+  lattice_type = parse_choice<lattice_id>("lattice", inputs.set_value("lattice", "SQUARE"), 
+    {{"CHAIN",lattice_id::CHAIN}, {"SQUARE",lattice_id::SQUARE}, 
+     {"HONEYCOMB",lattice_id::HONEYCOMB}, {"SIMPLECUBIC",lattice_id::SIMPLECUBIC}});
+  lattice_dims = lattice_size(inputs.set_value("L1", 4), 
+    inputs.set_value("L2", lattice_type==lattice_id::CHAIN ? 1 : 4), 
+    inputs.set_value("L3", lattice_type==lattice_id::SIMPLECUBIC ? 4 : 1));
+  // boundary conditions: default ones of the lattice unless given
+  const std::vector<std::pair<std::string,bc_t> > bc_names = {{"PERIODIC",bc_t::PERIODIC}, 
+    {"ANTIPERIODIC",bc_t::ANTIPERIODIC}, {"OPEN",bc_t::OPEN}};
+  lattice_bc bc = Lattice::default_bc(lattice_type);
+  bc_t bc1 = bc.L1_bc(), bc2 = bc.L2_bc(), bc3 = bc.L3_bc();
+  if (inputs.have("bc1")) bc1 = parse_choice<bc_t>("bc1", inputs.set_value("bc1",""), bc_names);
+  if (inputs.have("bc2")) bc2 = parse_choice<bc_t>("bc2", inputs.set_value("bc2",""), bc_names);
+  if (inputs.have("bc3")) bc3 = parse_choice<bc_t>("bc3", inputs.set_value("bc3",""), bc_names);
+  bc.set(bc1, bc2, bc3);
+  site_order order = parse_choice<site_order>("site_order", 
+    inputs.set_value("site_order", "ROW_MAJOR"), {{"ROW_MAJOR",site_order::ROW_MAJOR}, 
+    {"MORTON",site_order::MORTON}, {"HILBERT",site_order::HILBERT}});
+  wavefunction = parse_choice<wf_id>("wavefunction", inputs.set_value("wavefunction", "BCS"),
+    {{"BCS",wf_id::BCS}});
+  if (!Wavefunction::supports(wavefunction, lattice_type)) {
+    throw std::invalid_argument("VMC::init: wavefunction '"+inputs.set_value("wavefunction", "BCS")
+      +"' is not implemented for lattice '"+inputs.set_value("lattice", "SQUARE")+"'");
+  }
+  hole_doping = inputs.set_value("hole_doping", 0.0);
+  Lattice lattice;
+  lattice.construct(lattice_type, lattice_dims, bc, order);
+  config.init(lattice, wavefunction, hole_doping);
+  table_mode tables = parse_choice<table_mode>("table_mode", 
+    inputs.set_value("table_mode", "PRIVATE"), {{"PRIVATE",table_mode::PRIVATE}, 
+    {"SHARED_MEMORY",table_mode::SHARED_MEMORY}, {"MAPPED_FILE",table_mode::MAPPED_FILE}, 
+    {"DISK_CACHE",table_mode::DISK_CACHE}});
+  config.set_table_mode(tables, inputs.set_value("table_dir", "."));
+  config.set_table_memo(inputs.set_value("table_memo", 1));
+  if (inputs.set_value("table_cleanup", false)) {
+    int n = Wavefunction::remove_unused_tables(tables, inputs.set_value("table_dir", "."));
+    std::cout << " removed "<<n<<" unused amplitude table(s)\n";
+  }
   num_vparams = config.num_vparams();
-  vparams.resize(num_vparams);
+  std::vector<double> v = inputs.set_vector("vparams", std::vector<double>(num_vparams, 1.0));
+  if (static_cast<int>(v.size()) != num_vparams) 
+    throw std::invalid_argument("VMC::init: 'vparams' needs "+std::to_string(num_vparams)+" values");
+  vparams = Eigen::Map<RealVector>(v.data(), num_vparams);
 
   // run parameters
-  num_samples = 2000;
-  warmup_steps = 500;
-  interval = 3;
+  num_samples = inputs.set_value("samples", 2000);
+  warmup_steps = inputs.set_value("warmup", 500);
+  interval = inputs.set_value("interval", 3);
+  if (num_samples<1 || warmup_steps<0 || interval<1) 
+    throw std::invalid_argument("VMC::init: invalid run lengths");
+  // (none: default seed of the generator)
+  rng_seed = inputs.set_value("seed", -1);
+  if (rng_seed >= 0) config.seed(rng_seed);
+
+  // run termination
+  mode = run_mode::FIXED_SAMPLES;
+  error_target_abs = 0.0;
+  error_target_rel = 0.0;
+  time_budget = 0.0;
+  min_samples = 100;
+  check_interval = 100;
+  run_mode m = parse_choice<run_mode>("run_mode", inputs.set_value("run_mode", "FIXED_SAMPLES"),
+    {{"FIXED_SAMPLES",run_mode::FIXED_SAMPLES}, {"ERROR_TARGET",run_mode::ERROR_TARGET}, 
+     {"TIME_BUDGET",run_mode::TIME_BUDGET}});
+  if (m == run_mode::ERROR_TARGET) {
+    set_error_target(inputs.set_value("error_abs", 0.0), inputs.set_value("error_rel", 0.0),
+      inputs.set_value("max_samples", 1000000));
+  }
+  else if (m == run_mode::TIME_BUDGET) {
+    set_time_budget(inputs.set_value("time_budget", 0.0), inputs.set_value("max_samples", 1000000));
+  }
+
+  // measurement in the sampling thread (by default)
+  set_measure_threads(inputs.set_value("measure_threads", 0), 
+    inputs.set_value("pipeline_capacity", 0));
+
+  // configuration archive & sample log
+  archive_file.clear();
+  archive_interval = 1;
+  std::string archive = inputs.set_value("archive", "");
+  if (!archive.empty()) set_config_archive(archive, inputs.set_value("archive_interval", 1));
+  sample_log_file = inputs.set_value("sample_log", "");
+  // phase profile (VMC_INSTRUMENT builds only)
+  profile_file = inputs.set_value("profile_report", "profile.json");
+  // timeline of the run (off if no file)
+  trace_file = inputs.set_value("trace", "");
+  trace_capacity = inputs.set_value("trace_events", 65536);
 
   // observables
   energy.init("Energy");
+  energy_moments.init(2);
+  moments_sample.resize(2);
+  energy_acf.init(4096);
+  measure_sz_corr = inputs.set_value("sz_correlation", false);
+  num_corr_classes = 0;
+
+  // twist averaging (off by default)
+  num_twist_threads = 1;
+  int n = inputs.set_value("twists", 0);
+  if (n > 0) {
+    twist_set type = parse_choice<twist_set>("twist_set", inputs.set_value("twist_set", "GRID"),
+      {{"GRID",twist_set::GRID}, {"RANDOM",twist_set::RANDOM}});
+    set_twist_average(type, n, inputs.set_value("twist_threads", 1));
+  }
+
+  // parameter sweep (off unless one of its lists is given)
+  param_sweep = ParamSweep();
+  have_sweep = false;
+  if (inputs.have("sweep_sizes")) {
+    for (const auto& size : parse_sizes("sweep_sizes", inputs.set_value("sweep_sizes", ""))) 
+      param_sweep.add_size(size);
+    have_sweep = true;
+  }
+  if (inputs.have("sweep_dopings")) {
+    for (const auto& x : inputs.set_vector("sweep_dopings", {})) param_sweep.add_hole_doping(x);
+    have_sweep = true;
+  }
+  if (inputs.have("sweep_vparams")) {
+    // consecutive groups of 'num_vparams' values
+    std::vector<double> w = inputs.set_vector("sweep_vparams", {});
+    if (w.empty() || w.size()%num_vparams != 0) {
+      throw std::invalid_argument("VMC::init: 'sweep_vparams' needs groups of "
+        +std::to_string(num_vparams)+" values");
+    }
+    for (std::size_t i=0; i<w.size(); i+=num_vparams) 
+      param_sweep.add_vparams(Eigen::Map<RealVector>(w.data()+i, num_vparams));
+    have_sweep = true;
+  }
+  if (inputs.have("sweep_seeds")) {
+    for (const auto& x : inputs.set_vector("sweep_seeds", {})) {
+      if (x<0.0 || x!=std::floor(x) || x>4294967295.0) 
+        throw std::invalid_argument("VMC::init: 'sweep_seeds' must be non-negative integers");
+      param_sweep.add_seed(static_cast<unsigned>(x));
+    }
+    have_sweep = true;
+  }
+  sweep_threads = inputs.set_value("sweep_threads", 1);
+  if (sweep_threads<1) throw std::invalid_argument("VMC::init: invalid 'sweep_threads'");
+  sweep_file = inputs.set_value("sweep_file", "sweep.txt");
+  // the points' tables as for a single run (PRIVATE by default)
+  sweep_tables = tables;
 
+  // results of earlier sweeps (off if no file); stored points with an error 
+  // above 'store_error_target' (if > 0) are topped up
+  result_store_file.clear();
+  sweep_error_target = 0.0;
+  std::string store = inputs.set_value("result_store", "");
+  if (!store.empty()) set_result_store(store, inputs.set_value("store_error_target", 0.0));
+
+  // sweeps & twist averaging run plain fixed-length chains: the options of 
+  // a single measuring run would be ignored
+  if (have_sweep || twists.num_twists()>0) {
+    std::string run = have_sweep ? "a parameter sweep" : "twist averaging";
+    std::vector<std::pair<std::string,bool> > options = {
+      {"run_mode", mode!=run_mode::FIXED_SAMPLES}, {"measure_threads", num_measure_threads>0},
+      {"archive", !archive_file.empty()}, {"sample_log", !sample_log_file.empty()}, 
+      {"sz_correlation", measure_sz_corr}, {"twists", have_sweep && twists.num_twists()>0}};
+    for (const auto& option : options) {
+      if (option.second) 
+        throw std::invalid_argument("VMC::init: '"+option.first+"' is not supported with "+run);
+    }
+  }
+  if (!have_sweep && !result_store_file.empty()) 
+    throw std::invalid_argument("VMC::init: 'result_store' needs a parameter sweep");
+
+  // misspelled names would silently run with the defaults
+  std::vector<std::string> unused = inputs.unused();
+  if (!unused.empty()) {
+    std::string names;
+    for (const auto& name : unused) names += " "+name;
+    throw std::invalid_argument("VMC::init: unknown input parameter(s):"+names);
+  }
   return 0;
 }
 
+void VMC::set_config_archive(const std::string& fname, const int& every)
+{
+  if (every<1) throw std::invalid_argument("VMC::set_config_archive: invalid interval");
+  archive_file = fname;
+  archive_interval = every;
+}
+
+void VMC::set_fixed_samples(const int& samples)
+{
+  if (samples<1) throw std::invalid_argument("VMC::set_fixed_samples: invalid sample number");
+  mode = run_mode::FIXED_SAMPLES;
+  num_samples = samples;
+}
+
+void VMC::set_error_target(const double& abs_err, const double& rel_err, 
+  const int& max_samples)
+{
+  if (abs_err<=0.0 && rel_err<=0.0) 
+    throw std::invalid_argument("VMC::set_error_target: no positive error target");
+  if (max_samples<min_samples) 
+    throw std::invalid_argument("VMC::set_error_target: sample limit too small");
+  mode = run_mode::ERROR_TARGET;
+  error_target_abs = abs_err;
+  error_target_rel = rel_err;
+  num_samples = max_samples;
+}
+
+void VMC::set_time_budget(const double& seconds, const int& max_samples)
+{
+  if (seconds<=0.0) throw std::invalid_argument("VMC::set_time_budget: invalid time budget");
+  if (max_samples<1) throw std::invalid_argument("VMC::set_time_budget: invalid sample number");
+  mode = run_mode::TIME_BUDGET;
+  time_budget = seconds;
+  num_samples = max_samples;
+}
+
+void VMC::set_measure_threads(const int& num_threads, const int& capacity)
+{
+  if (num_threads<0) throw std::invalid_argument("VMC::set_measure_threads: invalid thread number");
+  num_measure_threads = num_threads;
+  pipeline_capacity = capacity;
+}
+
+void VMC::set_twist_average(const twist_set& type, const int& n, const int& num_threads)
+{
+  if (num_threads<1) throw std::invalid_argument("VMC::set_twist_average: invalid thread number");
+  // (the run's seed, as for the chains of the twists)
+  twists.init(config.lattice(), type, n, rng_seed>=0 ? rng_seed : 1);
+  num_twist_threads = num_threads;
+}
+
 int VMC::run_simulation(void) 
 {
+  begin_trace();
+  if (twists.num_twists() > 0) {
+    run_twist_average();
+    end_trace();
+    return 0;
+  }
+  start_time = clock::now();
   // set variational parameters
-  vparams.setOnes();
   config.build(vparams);
 
   // warmup run
-  config.init_state();
-  for (int n=0; n<warmup_steps; ++n) {
-    config.update_state();
-  } 
+  {
+    TRACE_SCOPE("warmup");
+    config.init_state();
+    for (int n=0; n<warmup_steps; ++n) {
+      config.update_state();
+    } 
+  }
   std::cout << " warmup done\n";
   // measuring run
   int sample = 0;
   int skip_count = interval;
   int iwork_done = 0;
+  long sweep = 0;
   // Initialize observables
   energy.reset();
+  energy_moments.clear();
+  energy_acf.clear();
+  num_corr_classes = measure_sz_corr ? config.lattice().num_disp_classes() : 0;
+  sample_data.resize(1+num_corr_classes);
+  if (measure_sz_corr) {
+    sz_corr.init("SzSz", num_corr_classes);
+    sz_corr.reset();
+    corr_data.resize(num_corr_classes);
+    corr_sample.resize(num_corr_classes);
+  }
+  if (!sample_log_file.empty()) {
+    std::vector<std::string> columns{"energy"};
+    for (int c=0; c<num_corr_classes; ++c) columns.push_back("szsz_"+std::to_string(c));
+    sample_log.open(sample_log_file, columns);
+  }
+  if (!archive_file.empty()) config_archive.open(archive_file, config.basis_state(), 
+    config.lattice().canonical_sites());
+  if (num_measure_threads > 0) {
+    pipeline.start(config, num_measure_threads, pipeline_capacity, 1+num_corr_classes, 
+      [this](config_snapshot& snapshot, mcdata::data_t& result) 
+      { 
+        result(0) = config.get_energy(snapshot); 
+        if (num_corr_classes > 0) {
+          config.get_sz_correlation(snapshot);
+          result.segment(1,num_corr_classes) = snapshot.sz_corr.array();
+        }
+      });
+  }
+  // nothing below should allocate (checked in VMC_ALLOC_CHECK builds)
+  alloc_check::arm();
+  clock::time_point measure_start = clock::now();
+  profile.reset();
+  config.profile().reset();
   while (sample < num_samples) {
-    if (skip_count == interval) {
+    // Make measurements
+    if (skip_count >= interval) {
+      measure();
       skip_count = 0;
       ++sample;
-      int iwork = int((100.0*sample)/num_samples);
+      if (config_archive.is_open() && sample%archive_interval==0) {
+        INSTRUMENT_PHASE(profile, IO);
+        TRACE_SCOPE("archive write");
+        config_archive.append(config.basis_state(), sweep);
+      }
+      int iwork = progress(sample);
       if (iwork%10==0 && iwork>iwork_done) {
         iwork_done = iwork;
         std::cout<<" done = "<<iwork<<"%\n";
       }
-      // Make measurements
-      energy << config.get_energy();
+      // termination check
+      if (mode==run_mode::ERROR_TARGET && sample>=min_samples 
+        && sample%check_interval==0) {
+        if (error_target_reached()) break;
+      }
+      else if (mode==run_mode::TIME_BUDGET) {
+        if (elapsed_time() >= time_budget) break;
+      }
     }
     config.update_state();
     skip_count++;
+    sweep++;
+  }
+  if (pipeline.is_running()) {
+    INSTRUMENT_PHASE(profile, MEASURE);
+    pipeline.finish();
+    collect_results(true);
+    pipeline.stop();
   }
+  std::chrono::duration<double> measure_time = clock::now()-measure_start;
+  alloc_check::disarm();
+  alloc_check::verify("VMC::run_simulation");
+  if (sample_log.is_open()) sample_log.close();
+  if (config_archive.is_open()) config_archive.close();
   // Finalize observables
   std::cout << " simulation done\n";
   config.print_stats();
   // results
   std::cout << "Energy = "<<energy.mean()<<" +/- "<<energy.stddev()<<"\n";
   std::cout << "Samples = "<<energy.num_samples()<<"\n";
+  print_energy_variance();
+  if (measure_sz_corr) print_sz_correlation();
+  if (mode != run_mode::FIXED_SAMPLES) print_run_summary();
+  if (num_measure_threads > 0) {
+    std::cout << "Pipeline stalls = "<<pipeline.num_stalls()<<"\n";
+  }
+  stats.sweeps = sweep;
+  stats.samples = energy.num_samples();
+  stats.seconds = measure_time.count();
+  stats.energy = energy.mean();
+  stats.energy_err = energy.stddev();
+  stats.tau_int = energy_acf.tau_int();
+  stats.effective_samples = energy_acf.effective_samples();
+  if (instrument::enabled && !profile_file.empty()) write_profile();
+  end_trace();
+
+  return 0;
+}
+
+int VMC::replay(const std::string& archive_file, const int& num_threads)
+{
+  // same wavefunction as in the sampling run
+  config.build(vparams);
+  energy.reset();
+  ConfigReplay replay(config);
+  std::uint64_t n = replay.run(archive_file, num_threads, 1, 
+    [this](config_snapshot& snapshot, mcdata::data_t& result) 
+    { result(0) = config.get_energy(snapshot); },
+    [this](const std::uint64_t& sweep, const mcdata::data_t& result) 
+    { energy << result; });
+  std::cout << " replay done\n";
+  std::cout << "Energy = "<<energy.mean()<<" +/- "<<energy.stddev()<<"\n";
+  std::cout << "Samples = "<<n<<"\n";
+  if (replay.num_skipped() > 0) {
+    std::cout << "Skipped (singular) = "<<replay.num_skipped()<<"\n";
+  }
+  return 0;
+}
+
+int VMC::run_twist_average(void)
+{
+  // fixed number of samples at every twist
+  start_time = clock::now();
+  twists.run(num_twist_threads, [this](const int& id, const Vector3d& twist, 
+    twist_result& result) { sample_twist(id, twist, result); });
+  std::cout << " simulation done\n";
+  // results
+  std::cout << "Twists = "<<twists.num_twists()
+    <<(twists.type()==twist_set::GRID ? " (grid)" : " (random)")<<"\n";
+  for (int t=0; t<twists.num_twists(); ++t) {
+    const Vector3d& theta = twists.twist(t);
+    const twist_result& r = twists.result(t);
+    std::cout << " twist = ("<<theta(0)<<", "<<theta(1)<<", "<<theta(2)<<")  E = "
+      <<r.mean<<" +/- "<<r.stddev<<"\n";
+  }
+  std::cout << "Energy = "<<twists.mean()<<" +/- "<<twists.stddev()<<"\n";
+  std::cout << "Samples = "<<twists.num_samples()<<"\n";
+  if (twists.type()==twist_set::RANDOM && twists.num_twists()>1) {
+    std::cout << "Twist sampling error = "<<twists.spread()<<"\n";
+  }
+  return 0;
+}
+
+void VMC::sample_twist(const int& twist_id, const Vector3d& twist, twist_result& result) const
+{
+  // an independent run (own lattice, wavefunction & chain) at the given twist
+  TRACE_SCOPE("twist");
+  Lattice lattice(config.lattice());
+  lattice.set_twist(twist);
+  SysConfig twist_config;
+  twist_config.init(lattice, wavefunction, hole_doping);
+  mcdata::MC_Data twist_energy("Energy");
+  unsigned seed = std::max(rng_seed,0)*1000003u + twist_id+1;
+  run_chain(twist_config, vparams, seed, num_samples, twist_energy);
+  result.mean = twist_energy.mean();
+  result.stddev = twist_energy.stddev();
+  result.num_samples = twist_energy.num_samples();
+}
+
+void VMC::run_chain(SysConfig& chain_config, const RealVector& chain_vparams, 
+  const unsigned& seed, const int& chain_samples, mcdata::MC_Data& chain_energy) const
+{
+  // plain fixed-length run in the calling thread
+  chain_config.seed(seed);
+  chain_config.build(chain_vparams);
+  chain_config.init_state();
+  for (int n=0; n<warmup_steps; ++n) chain_config.update_state();
+  for (int sample=0; sample<chain_samples; ++sample) {
+    for (int n=0; n<interval; ++n) chain_config.update_state();
+    chain_energy << chain_config.get_energy();
+  }
+}
+
+void VMC::set_result_store(const std::string& fname, const double& error_target)
+{
+  if (error_target<0.0) throw std::invalid_argument("VMC::set_result_store: invalid error target");
+  result_store_file = fname;
+  sweep_error_target = error_target;
+}
+
+std::string VMC::run_spec(const Lattice& lattice, const double& spec_doping, 
+  const RealVector& spec_vparams, const unsigned& seed) const
+{
+  // everything the result depends on (not the site order or thread counts)
+  std::ostringstream spec;
+  spec << std::setprecision(17);
+  spec << "lattice=" << static_cast<int>(lattice.id()) << " L=" << lattice.size_L1() 
+    << "," << lattice.size_L2() << "," << lattice.size_L3() << " bc=" 
+    << static_cast<int>(lattice.bc_L1()) << "," << static_cast<int>(lattice.bc_L2()) 
+    << "," << static_cast<int>(lattice.bc_L3()) << " wf=" << static_cast<int>(wavefunction)
+    << " doping=" << spec_doping << " vparams=";
+  for (int i=0; i<spec_vparams.size(); ++i) spec << (i>0 ? "," : "") << spec_vparams(i);
+  spec << " warmup=" << warmup_steps << " interval=" << interval << " samples=" 
+    << num_samples << " seed=" << seed;
+  return spec.str();
+}
+
+void VMC::run_point(const ParamSweep& sweep, const sweep_point& p, const table_mode& tables,
+  stored_result& result, std::string& source)
+{
+  TRACE_SCOPE("sweep point");
+  const Lattice& lattice = sweep.lattice(p.size);
+  std::string spec = run_spec(lattice, p.hole_doping, p.vparams, p.seed);
+  int samples = num_samples;
+  unsigned seed = p.seed;
+  source = "new";
+  if (result_store.is_open() && result_store.find(spec, result)) {
+    source = "stored";
+    // (an unknown error bar never meets the target)
+    if (sweep_error_target<=0.0) return;
+    if (result.stddev>=0.0 && result.stddev<=sweep_error_target) return;
+    // top up: the missing samples (err ~ 1/sqrt(N)), 10% extra, on a 
+    // new chain with a seed of its own (not shorter than num_samples/10, 
+    // as it pays for its own warmup); with an unknown error, another 
+    // num_samples
+    if (result.stddev >= 0.0) {
+      double ratio = result.stddev/sweep_error_target;
+      samples = static_cast<int>(std::ceil(1.1*result.num_samples*(ratio*ratio-1.0)));
+      samples = std::max(samples, std::max(num_samples/10, 1));
+    }
+    seed = p.seed + 1000003u*(result.num_topups+1);
+    source = "topup";
+  }
+  clock::time_point t0 = clock::now();
+  SysConfig point_config;
+  point_config.init(lattice, wavefunction, p.hole_doping);
+  point_config.set_table_mode(tables);
+  mcdata::MC_Data point_energy("Energy");
+  run_chain(point_config, p.vparams, seed, samples, point_energy);
+  std::chrono::duration<double> dt = clock::now()-t0;
+  stored_result run;
+  run.mean = point_energy.mean();
+  run.stddev = point_energy.stddev();
+  run.tau = point_energy.tau();
+  run.num_samples = point_energy.num_samples();
+  run.cost = dt.count();
+  result = (source=="topup") ? ResultStore::combine(result, run) : run;
+  if (result_store.is_open()) result_store.put(spec, result);
+}
+
+int VMC::run_sweep(void)
+{
+  if (!have_sweep) throw std::logic_error("VMC::run_sweep: no sweep in the input");
+  return run_sweep(param_sweep, sweep_threads, sweep_file, sweep_tables);
+}
+
+int VMC::run_sweep(ParamSweep& sweep, const int& num_threads, const std::string& fname,
+  const table_mode& tables)
+{
+  start_time = clock::now();
+  const Lattice& lattice = config.lattice();
+  sweep.make_points(lattice_type, lattice_bc(lattice.bc_L1(), lattice.bc_L2(), lattice.bc_L3()),
+    num_vparams, lattice.order());
+  if (!result_store_file.empty()) result_store.open(result_store_file);
+  mcdata::AsyncWriter& writer = mcdata::AsyncWriter::global();
+  std::ostringstream heading;
+  heading << "# sweep: " << sweep.num_points() << " points\n";
+  heading << "#" << std::setw(5) << "id" << std::setw(6) << "L1" << std::setw(6) << "L2" 
+    << std::setw(6) << "L3" << std::setw(10) << "doping" << std::setw(8) << "seed";
+  for (int i=0; i<num_vparams; ++i) heading << std::setw(13) << "vparam_"+std::to_string(i);
+  heading << std::setw(15) << "energy" << std::setw(15) << "err" << std::setw(10) << "samples"
+    << std::setw(10) << "time(s)" << std::setw(8) << "source" << "\n";
+  writer.write(fname, heading.str(), true);
 
+  begin_trace();
+  TaskPool pool(num_threads);
+  for (int i=0; i<sweep.num_points(); ++i) {
+    pool.submit([this,&sweep,&writer,&fname,&tables,i](void) 
+    {
+      const sweep_point& p = sweep.point(i);
+      stored_result result;
+      std::string source;
+      run_point(sweep, p, tables, result, source);
+      std::ostringstream line;
+      line << std::setw(6) << p.id << std::setw(6) << p.size.L1() << std::setw(6) 
+        << p.size.L2() << std::setw(6) << p.size.L3() << std::setw(10) << p.hole_doping
+        << std::setw(8) << p.seed;
+      line << std::scientific << std::uppercase << std::setprecision(6);
+      for (int k=0; k<p.vparams.size(); ++k) line << std::setw(13) << p.vparams(k);
+      line << std::setw(15) << result.mean << std::setw(15) << result.stddev;
+      line << std::fixed << std::nouppercase << std::setprecision(2);
+      line << std::setw(10) << result.num_samples << std::setw(10) << result.cost 
+        << std::setw(8) << source << "\n";
+      writer.write(fname, line.str());
+    });
+  }
+  pool.run();
+  {
+    TRACE_SCOPE("store sync");
+    writer.sync();
+  }
+  end_trace();
+  std::cout << " sweep done: " << sweep.num_points() << " points, " << pool.num_steals() 
+    << " steals, " << elapsed_time() << " s\n";
   return 0;
-}
\ No newline at end of file
+}
+
+void VMC::measure(void)
+{
+  INSTRUMENT_PHASE(profile, MEASURE);
+  TRACE_SCOPE("measure");
+  if (!pipeline.is_running()) {
+    sample_data(0) = config.get_energy();
+    if (num_corr_classes > 0) {
+      config.get_sz_correlation(corr_data);
+      sample_data.segment(1,num_corr_classes) = corr_data.array();
+    }
+    record_sample();
+    return;
+  }
+  collect_results();
+  // full ring: wait for the oldest measurement rather than sweep on
+  if (pipeline.wait_slot(sample_data)) record_sample();
+  pipeline.push(config);
+}
+
+void VMC::collect_results(const bool& wait)
+{
+  if (wait) {
+    while (pipeline.wait_result(sample_data)) record_sample();
+  }
+  else {
+    while (pipeline.pop_result(sample_data)) record_sample();
+  }
+}
+
+void VMC::record_sample(void)
+{
+  energy << sample_data(0);
+  if (num_corr_classes > 0) {
+    corr_sample = sample_data.segment(1,num_corr_classes);
+    sz_corr << corr_sample;
+  }
+  moments_sample(0) = sample_data(0);
+  moments_sample(1) = sample_data(0)*sample_data(0);
+  energy_moments << moments_sample;
+  energy_acf << sample_data(0);
+  if (sample_log.is_open()) {
+    INSTRUMENT_PHASE(profile, IO);
+    TRACE_SCOPE("sample log write");
+    sample_log << sample_data;
+  }
+}
+
+void VMC::begin_trace(void)
+{
+  if (trace_file.empty()) return;
+  trace::start(trace_capacity);
+  trace::set_thread_name("main");
+}
+
+void VMC::end_trace(void)
+{
+  if (trace_file.empty()) return;
+  trace::stop();
+  if (!trace::write(trace_file)) std::cout << "VMC::end_trace: can't write "<<trace_file<<"\n";
+  else std::cout << "Trace written to "<<trace_file<<"\n";
+}
+
+void VMC::write_profile(void) const
+{
+  // the sampler's phases & moves with the measurements of this thread
+  instrument::Profile total(profile);
+  total.add(config.profile());
+  std::ofstream fs(profile_file);
+  total.write_json(fs);
+  if (!fs) std::cout << "VMC::write_profile: can't write "<<profile_file<<"\n";
+  else std::cout << "Profile written to "<<profile_file<<"\n";
+}
+
+double VMC::elapsed_time(void) const
+{
+  std::chrono::duration<double> dt = clock::now()-start_time;
+  return dt.count();
+}
+
+bool VMC::error_target_reached(void) const
+{
+  double err = energy.stddev();
+  // negative error means less than two samples in the bin
+  if (err < 0.0) return false;
+  // with a reliable tau_int, the error is also checked against 
+  // 2*tau_int*var/N and the binning needs not have converged
+  bool tau_reliable = energy_acf.reliable();
+  if (tau_reliable) err = std::max(err, energy_acf.stddev());
+  bool reached = false;
+  if (error_target_abs>0.0 && err<=error_target_abs) reached = true;
+  if (error_target_rel>0.0 && err<=error_target_rel*std::abs(energy.mean())) reached = true;
+  return reached && (tau_reliable || energy.converged());
+}
+
+int VMC::progress(const int& sample) const
+{
+  if (mode==run_mode::TIME_BUDGET) {
+    int iwork = int(100.0*elapsed_time()/time_budget);
+    return std::min(iwork, 100);
+  }
+  return int((100.0*sample)/num_samples);
+}
+
+void VMC::print_energy_variance(std::ostream& os) const
+{
+  // <E^2>-<E>^2 with jackknife error, on blocks of the decorrelated size 
+  std::uint64_t block_size = energy.decorrelated_block_size();
+  if (energy_moments.num_blocks(block_size) < 2) return;
+  auto variance = [](const mcdata::block_array& m, mcdata::block_array& f) 
+    { f = m.row(1) - m.row(0).square(); };
+  mcdata::resample_result var = energy_moments.jackknife(variance, block_size);
+  os << "Energy variance = "<<var.mean(0)<<" +/- "<<var.stddev(0)<<"\n";
+}
+
+void VMC::print_sz_correlation(std::ostream& os) const
+{
+  // one line per class of equivalent pairs: shortest displacement of a 
+  // representative pair, number of pairs, value
+  const Lattice& lattice = config.lattice();
+  os << "SzSz correlation (" << num_corr_classes << " classes, " 
+     << lattice.num_symm_ops() << " point group operations):\n";
+  std::streamsize dp = os.precision(); 
+  os << std::noshowpoint;
+  for (int c=0; c<num_corr_classes; ++c) {
+    const Vector3d& R = lattice.class_vector(c);
+    os << std::fixed << std::setprecision(3);
+    os << " R = (" << std::setw(7) << R(0) << "," << std::setw(7) << R(1) << "," 
+       << std::setw(7) << R(2) << ")  pairs = " << std::setw(5) 
+       << lattice.class_multiplicity(c) << "  ";
+    os << std::resetiosflags(std::ios_base::floatfield) << std::setprecision(dp);
+    os << sz_corr.mean(c) << " +/- " << sz_corr.stddev(c) << "\n";
+  }
+}
+
+void VMC::print_run_summary(std::ostream& os) const
+{
+  double t = elapsed_time();
+  std::streamsize dp = os.precision(); 
+  os << std::noshowpoint;
+  os << "--------------------------------------\n";
+  if (mode==run_mode::ERROR_TARGET) {
+    os << " run mode = error target (abs = " << error_target_abs
+       << ", rel = " << error_target_rel << ")\n";
+    if (error_target_reached()) os << " stopped: error target reached\n";
+    else os << " stopped: sample limit reached, error target NOT reached\n";
+  }
+  else {
+    os << " run mode = time budget (" << time_budget << " s)\n";
+    if (energy.num_samples() < static_cast<unsigned>(num_samples)) 
+      os << " stopped: time budget exhausted\n";
+    else os << " stopped: sample limit reached\n";
+  }
+  os << " error = " << energy.stddev() << " (" << energy.conv_str(0) << " )\n";
+  os << " tau_int = " << energy_acf.tau_int() << " (window = " << energy_acf.window();
+  os << (energy_acf.reliable() ? "" : ", NOT reliable") << ")\n";
+  os << " effective samples = " << int(energy_acf.effective_samples()) << "\n";
+  os << std::fixed << std::showpoint << std::setprecision(2);
+  os << " wall time = " << t << " s\n";
+  if (t > 0.0) os << " samples/s = " << energy.num_samples()/t << "\n";
+  os << "--------------------------------------\n";
+  os << std::resetiosflags(std::ios_base::floatfield | std::ios_base::showpoint);
+  os << std::setprecision(dp);
+}
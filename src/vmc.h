@@ -9,8 +9,42 @@
 #define VMC_H
 
 #include <iostream>
+#include <chrono>
+#include <sstream>
 #include "sysconfig.h"
+#include "pipeline.h"
+#include "alloc_check.h"
 #include "mcdata/mc_observable.h"
+#include "mcdata/resampler.h"
+#include "mcdata/autocorr.h"
+#include "mcdata/sample_log.h"
+#include "replay.h"
+#include "twist_average.h"
+#include "task_pool.h"
+#include "sweep.h"
+#include "result_store.h"
+#include "input.h"
+
+/* Termination rule of the measuring run:
+*   FIXED_SAMPLES: stop after 'num_samples' measurements
+*   ERROR_TARGET: stop once the binned error bar of the energy reaches the 
+*     absolute or relative target and the binning analysis has converged
+*     ('num_samples' is then an upper limit)
+*   TIME_BUDGET: stop when the wall-clock budget (warmup included) runs out
+*/
+enum class run_mode {FIXED_SAMPLES, ERROR_TARGET, TIME_BUDGET};
+
+// throughput & result of the last measuring run (warmup excluded)
+struct run_stats
+{
+	long sweeps{0};
+	int samples{0};
+	double seconds{0.0};
+	double energy{0.0};
+	double energy_err{0.0};
+	double tau_int{-1.0};
+	double effective_samples{0.0};
+};
 
 class VMC
 {
@@ -18,19 +52,133 @@ public:
 	VMC() {}
 	~VMC() {}
 	int init(void);
+	int init(const input::Parameters& inputs);
 	int run_simulation(void);
+	int replay(const std::string& archive_file, const int& num_threads=1);
+	void set_fixed_samples(const int& samples); 
+	void set_error_target(const double& abs_err, const double& rel_err=0.0, 
+		const int& max_samples=1000000); 
+	void set_time_budget(const double& seconds, const int& max_samples=1000000); 
+	void set_measure_threads(const int& num_threads, const int& capacity=0); 
+	void set_amplitude_table(const table_mode& mode, const std::string& dir="")
+		{ config.set_table_mode(mode, dir); }
+	void set_sample_log(const std::string& fname) { sample_log_file = fname; }
+	void set_config_archive(const std::string& fname, const int& every=1); 
+	void set_sz_correlation(const bool& on=true) { measure_sz_corr = on; }
+	// twist averaged run: 'n' twists (per axis for a GRID), 'num_threads' at a time
+	void set_twist_average(const twist_set& type, const int& n, const int& num_threads=1); 
+	// the sweep given in the input (sweep_* parameters), if any
+	bool sweep_given(void) const { return have_sweep; }
+	int run_sweep(void);
+	/* All points of 'sweep' in this process, on a work-stealing pool of 
+	*  'num_threads' threads; a result line goes to 'fname' as each point 
+	*  finishes. The points' amplitude tables are kept as given by 'tables'. */
+	int run_sweep(ParamSweep& sweep, const int& num_threads, const std::string& fname,
+		const table_mode& tables=table_mode::PRIVATE);
+	/* Sweep points found in the store are not rerun; if their error bar 
+	*  misses 'error_target' (if > 0) they are topped up with extra samples. */
+	void set_result_store(const std::string& fname, const double& error_target=0.0); 
+	const run_stats& last_run(void) const { return stats; }
 private:
+	using clock = std::chrono::steady_clock;
+	lattice_id lattice_type;
+	lattice_size lattice_dims;
+	wf_id wavefunction;
+	double hole_doping;
 	SysConfig config;
 	RealVector vparams;
 	int num_vparams;
 	int num_samples;
 	int warmup_steps;
 	int interval;
+	int rng_seed; // -1: default seed
+
+	// run termination
+	run_mode mode;
+	double error_target_abs;
+	double error_target_rel;
+	double time_budget; // seconds
+	int min_samples;
+	int check_interval; // samples between error checks
+	clock::time_point start_time;
+	run_stats stats;
+
+	// measurement pipeline (off if 'num_measure_threads' = 0)
+	int num_measure_threads;
+	int pipeline_capacity;
+	MeasurePipeline pipeline;
 
 	// observables
 	mcdata::MC_Observable energy;
+	mcdata::data_t sample_data;
+	// E and E^2 jointly, for the energy variance
+	mcdata::Resampler energy_moments;
+	mcdata::data_t moments_sample;
+	// FFT estimate of tau_int of the energy (recent samples only)
+	mcdata::AutoCorrelation energy_acf;
+	// <S^z_i S^z_j> per class of symmetry equivalent pairs (opt-in), it 
+	// follows the energy in 'sample_data'
+	bool measure_sz_corr;
+	int num_corr_classes;
+	mcdata::MC_Observable sz_corr;
+	RealVector corr_data;
+	mcdata::data_t corr_sample;
+
+	// per-sample log (off if 'sample_log_file' is empty)
+	std::string sample_log_file;
+	mcdata::SampleLog sample_log;
+
+	// archive of every 'archive_interval'-th sampled state (off if no file)
+	std::string archive_file;
+	int archive_interval;
+	ConfigArchive config_archive;
+
+	// twist averaging (off if no twists)
+	TwistAverage twists;
+	int num_twist_threads;
+
+	// parameter sweep of the input
+	bool have_sweep;
+	ParamSweep param_sweep;
+	int sweep_threads;
+	std::string sweep_file;
+	table_mode sweep_tables;
+
+	// results of earlier sweep runs (off if no file)
+	std::string result_store_file;
+	double sweep_error_target;
+	ResultStore result_store;
+
+	// phase times of the measuring run (VMC_INSTRUMENT builds, JSON report)
+	std::string profile_file;
+	instrument::Profile profile;
+
+	// Chrome trace of the run (off if no file), 'trace_capacity' events per thread
+	std::string trace_file;
+	int trace_capacity;
+
+	void measure(void);
+	void collect_results(const bool& wait=false);
+	void record_sample(void);
+	double elapsed_time(void) const;
+	bool error_target_reached(void) const;
+	int progress(const int& sample) const;
+	int run_twist_average(void);
+	void sample_twist(const int& twist_id, const Vector3d& twist, twist_result& result) const;
+	void run_chain(SysConfig& chain_config, const RealVector& chain_vparams, 
+		const unsigned& seed, const int& chain_samples, mcdata::MC_Data& chain_energy) const;
+	std::string run_spec(const Lattice& lattice, const double& spec_doping, 
+		const RealVector& spec_vparams, const unsigned& seed) const;
+	void run_point(const ParamSweep& sweep, const sweep_point& p, const table_mode& tables,
+		stored_result& result, std::string& source);
+	void write_profile(void) const;
+	void begin_trace(void);
+	void end_trace(void);
+	void print_run_summary(std::ostream& os=std::cout) const;
+	void print_energy_variance(std::ostream& os=std::cout) const;
+	void print_sz_correlation(std::ostream& os=std::cout) const;
 };
 
 
 
-#endif
\ No newline at end of file
+#endif
@@ -5,8 +5,13 @@
 * @Last Modified time: 2019-03-24 11:48:35
 *----------------------------------------------------------------------------*/
 // File: wavefunction.cpp
+#include <cerrno>
+#include <sys/stat.h>
 #include "wavefunction.h"
 
+const int Wavefunction::table_format_version_;
+const char* const Wavefunction::table_prefix_ = "simplevmc_psi_";
+
 void Wavefunction::init(const wf_id& id, const Lattice& lattice, const double& hole_doping)
 {
 	id_ = id;
@@ -21,7 +26,71 @@ void Wavefunction::init(const wf_id& id, const Lattice& lattice, const double& h
 			break;
 	}
   set_particle_num(hole_doping);
-  psi_.resize(num_sites_,num_sites_);
+  psi_table_.reset();
+  psi_ = nullptr;
+  psi_ld_ = num_sites_;
+  have_dispersion_ = false;
+  memo_.clear();
+}
+
+bool Wavefunction::supports(const wf_id& id, const lattice_id& lattice)
+{
+  // the other lattices are geometry only for now
+  return id==wf_id::BCS && lattice==lattice_id::SQUARE;
+}
+
+int Wavefunction::remove_unused_tables(const table_mode& mode, const std::string& dir)
+{
+  return AmplitudeTable::remove_unused(mode, dir, table_prefix_);
+}
+
+void Wavefunction::set_memo(const int& capacity, const double& tolerance)
+{
+  if (capacity<0 || tolerance<0.0) throw std::invalid_argument("Wavefunction::set_memo: invalid input");
+  memo_capacity_ = capacity;
+  memo_tolerance_ = tolerance;
+  while (static_cast<int>(memo_.size()) > memo_capacity_) memo_.pop_back();
+}
+
+void Wavefunction::set_table_mode(const table_mode& mode, const std::string& dir)
+{
+  table_mode_ = mode;
+  if (!dir.empty()) table_dir_ = dir;
+  if (table_mode_ == table_mode::DISK_CACHE) {
+    if (mkdir(table_dir_.c_str(), 0755)!=0 && errno!=EEXIST) 
+      throw std::runtime_error("Wavefunction::set_table_mode: can't create '"+table_dir_+"'");
+  }
+}
+
+KeyHash Wavefunction::table_key(const Lattice& lattice, const RealVector& vparams) const
+{
+  // everything the table depends on
+  KeyHash key;
+  key.add(table_format_version_);
+  key.add(lattice.id());
+  key.add(lattice.size_L1());
+  key.add(lattice.size_L2());
+  key.add(lattice.size_L3());
+  key.add(lattice.bc_L1());
+  key.add(lattice.bc_L2());
+  key.add(lattice.bc_L3());
+  // (keeps the keys of ROW_MAJOR tables unchanged)
+  if (lattice.order() != site_order::ROW_MAJOR) key.add(lattice.order());
+  if (lattice.has_twist()) key.add(lattice.twist().data(), 3*sizeof(double));
+  key.add(id_);
+  key.add(num_upspins_);
+  key.add(num_dnspins_);
+  key.add(vparams.data(), sizeof(double)*vparams.size());
+  return key;
+}
+
+KeyHash Wavefunction::context_key(const Lattice& lattice) const
+{
+  // all the table depends on but 'vparams', and where it is kept
+  KeyHash key = table_key(lattice, RealVector());
+  key.add(table_mode_);
+  key.add(table_dir_.data(), table_dir_.size());
+  return key;
 }
 
 void Wavefunction::set_particle_num(const double& hole_doping) 
@@ -50,37 +119,86 @@ void Wavefunction::set_particle_num(const double& hole_doping)
 void Wavefunction::compute(const Lattice& lattice, const RealVector& vparams, 
     const int& start_pos, const bool& psi_gradient)
 {
-  switch (id_) {
-    case wf_id::BCS: 
-      compute_BCS(lattice, vparams, start_pos, psi_gradient);
-      break;
-    default: 
-      throw std::range_error("This wavefunction not implemented\n");
-      break;
+  // built before (same lattice & storage, about the same 'vparams')?
+  std::uint64_t context = context_key(lattice).value();
+  for (auto it=memo_.begin(); it!=memo_.end(); ++it) {
+    if (it->context==context && it->vparams.size()==vparams.size() && 
+      (it->vparams-vparams).cwiseAbs().maxCoeff()<=memo_tolerance_) {
+      memo_.splice(memo_.begin(), memo_, it);
+      psi_table_ = memo_.front().table;
+      psi_ = psi_table_->data();
+      psi_ld_ = num_sites_;
+      return;
+    }
+  }
+  // a new table each time, walkers may still be using the old one 
+  std::string name("");
+  KeyHash key;
+  if (table_mode_ != table_mode::PRIVATE) {
+    key = table_key(lattice, vparams);
+    name = table_prefix_ + key.str();
+    if (table_mode_ == table_mode::SHARED_MEMORY) name = "/" + name;
+    else name = table_dir_ + "/" + name;
+  }
+  psi_table_ = std::make_shared<AmplitudeTable>();
+  if (psi_table_->create(table_mode_, num_sites_, num_sites_, name, key.value())) {
+    ComplexMatrixMap psi_mat(psi_table_->mutable_data(), num_sites_, num_sites_);
+    try {
+      switch (id_) {
+        case wf_id::BCS: 
+          compute_BCS(lattice, vparams, start_pos, psi_mat, psi_gradient);
+          break;
+        default: 
+          throw std::range_error("This wavefunction not implemented\n");
+          break;
+      }
+    }
+    catch (...) {
+      // walkers waiting for it give up
+      psi_table_.reset();
+      psi_ = nullptr;
+      throw;
+    }
+    psi_table_->publish();
+  }
+  // else: already built by another walker
+  psi_ = psi_table_->data();
+  psi_ld_ = num_sites_;
+  // remember it (least recently used one goes out)
+  if (memo_capacity_ > 0) {
+    memo_.push_front(memo_entry{context, vparams, psi_table_});
+    while (static_cast<int>(memo_.size()) > memo_capacity_) memo_.pop_back();
   }
 }
 
 void Wavefunction::compute_BCS(const Lattice& lattice, const RealVector& vparams, 
-    const int& start_pos, const bool& psi_gradient)
+    const int& start_pos, ComplexMatrixMap& psi_mat, const bool& psi_gradient)
 {
   if (lattice.id() == lattice_id::SQUARE) {
 
-    // Chemical potential (non-interacting system) 
-    ch_potential_ = 0.0;
-    std::vector<double> ek;
-    for (int k=0; k<lattice.num_kpoints(); ++k) {
-      Vector3d kvec = lattice.kpoint(k);
-      double cos_kx = std::cos(kvec[0]);
-      double cos_ky = std::cos(kvec[1]);
-      double e = -2.0*(cos_kx+cos_ky);
-      ek.push_back(e);
-    }
-    std::sort(ek.begin(),ek.end());
-    if (num_upspins_ < num_sites_) {
-      ch_potential_ = 0.5*(ek[num_upspins_-1]+ek[num_upspins_]);
-    }
-    else {
-      ch_potential_ = ek[num_upspins_-1];
+    // dispersion & chemical potential do not depend on 'vparams'
+    std::uint64_t lattice_key = table_key(lattice, RealVector()).value();
+    if (!have_dispersion_ || dispersion_key_!=lattice_key) {
+      ek_.resize(lattice.num_kpoints());
+      gk_.resize(lattice.num_kpoints());
+      for (int k=0; k<lattice.num_kpoints(); ++k) {
+        Vector3d kvec = lattice.kpoint(k);
+        double cos_kx = std::cos(kvec[0]);
+        double cos_ky = std::cos(kvec[1]);
+        ek_[k] = -2.0*(cos_kx+cos_ky);
+        gk_[k] = cos_kx-cos_ky;
+      }
+      // Chemical potential (non-interacting system) 
+      std::vector<double> ek(ek_.data(), ek_.data()+ek_.size());
+      std::sort(ek.begin(),ek.end());
+      if (num_upspins_ < num_sites_) {
+        ch_potential_ = 0.5*(ek[num_upspins_-1]+ek[num_upspins_]);
+      }
+      else {
+        ch_potential_ = ek[num_upspins_-1];
+      }
+      have_dispersion_ = true;
+      dispersion_key_ = lattice_key;
     }
 
     //------------BCS wavefunction for SQUARE lattice-----------
@@ -89,17 +207,14 @@ void Wavefunction::compute_BCS(const Lattice& lattice, const RealVector& vparams
     // k-space pair amplitudes 'phi_k' 
     RealVector phi_k(lattice.num_kpoints());
     for (int k=0; k<lattice.num_kpoints(); ++k) {
-      Vector3d kvec = lattice.kpoint(k);
-      double cos_kx = std::cos(kvec[0]);
-      double cos_ky = std::cos(kvec[1]);
-      double ek = -2.0*(cos_kx+cos_ky) - ch_potential_;
+      double ek = ek_[k] - ch_potential_;
       if (std::abs(delta_sc) < 1.0E-12) {
         // wavefunction reduces to FEARMISEA
         if (ek < 0.0) phi_k[k] = 1.0;
         else phi_k[k] = 0.0;
       }
       else {
-        double deltak = delta_sc*(cos_kx-cos_ky); 
+        double deltak = delta_sc*gk_[k]; 
         double deltak_sq = deltak*deltak;
         if (std::sqrt(deltak_sq)<1.0E-12 && ek<0.0) {
           // singular k-points
@@ -112,19 +227,37 @@ void Wavefunction::compute_BCS(const Lattice& lattice, const RealVector& vparams
       }
       //std::cout << "phi_k["<<k<<"] = "<<phi_k[k]<<"\n"; getchar();
     }
-    // pair amplitudes in lattice space
+    /* Pair amplitudes in lattice space. They depend only on the (integer) 
+      displacement R_i-R_j, so the k-sum is done once per displacement. */
+    int L1 = lattice.size_L1();
+    int L2 = lattice.size_L2();
+    int L3 = lattice.size_L3();
+    int D1 = 2*L1-1;
+    int D2 = 2*L2-1;
+    ComplexVector phi_r(D1*D2*(2*L3-1));
+    int n = 0;
+    for (int d3=-(L3-1); d3<L3; ++d3) {
+      for (int d2=-(L2-1); d2<L2; ++d2) {
+        for (int d1=-(L1-1); d1<L1; ++d1) {
+          Vector3d R_ij(d1, d2, d3);
+          std::complex<double> ksum=0.0;
+          for (int k=0; k<lattice.num_kpoints(); ++k) {
+            Vector3d kvec = lattice.kpoint(k);
+            std::complex<double> exp_kdor=std::exp(II*kvec.dot(R_ij));
+            ksum += phi_k[k] * exp_kdor;
+          }
+          phi_r[n++] = ksum/double(lattice.num_kpoints());
+        }
+      }
+    }
     for (int i=0; i<num_sites_; ++i) {
       Vector3d R_i = lattice.site(i).cell_coord();
       for (int j=0; j<num_sites_; ++j) {
-        Vector3d R_j = lattice.site(j).cell_coord();
-        Vector3d R_ij = R_i-R_j;
-        std::complex<double> ksum=0.0;
-        for (int k=0; k<lattice.num_kpoints(); ++k) {
-          Vector3d kvec = lattice.kpoint(k);
-          std::complex<double> exp_kdor=std::exp(II*kvec.dot(R_ij));
-          ksum += phi_k[k] * exp_kdor;
-        }
-        psi_(i,j) = ksum/double(lattice.num_kpoints());
+        Vector3d R_ij = R_i-lattice.site(j).cell_coord();
+        int d1 = static_cast<int>(std::round(R_ij[0])) + L1-1;
+        int d2 = static_cast<int>(std::round(R_ij[1])) + L2-1;
+        int d3 = static_cast<int>(std::round(R_ij[2])) + L3-1;
+        psi_mat(i,j) = phi_r[d1 + D1*(d2 + D2*d3)];
         //std::cout << "phi["<<i<<","<<j<<"] = "<<psi_(i,j)<<"\n"; getchar();
       }
     }
@@ -139,7 +272,7 @@ void Wavefunction::get_amplitudes(ComplexMatrix& ampl_mat, const std::vector<int
 {
   for (int i=0; i<row.size(); ++i) {
     for (int j=0; j<col.size(); ++j) {
-      ampl_mat(i,j) = psi_(row[i],col[j]);
+      ampl_mat(i,j) = psi(row[i],col[j]);
     }
   }
 }
@@ -148,20 +281,20 @@ void Wavefunction::get_amplitudes(ColVector& ampl_vec, const int& irow,
     const std::vector<int>& col) const
 {
   for (int j=0; j<col.size(); ++j)
-    ampl_vec[j] = psi_(irow,col[j]);
+    ampl_vec[j] = psi(irow,col[j]);
 }
 
 void Wavefunction::get_amplitudes(RowVector& ampl_vec, const std::vector<int>& row,
     const int& icol) const
 {
   for (int j=0; j<row.size(); ++j)
-    ampl_vec[j] = psi_(row[j],icol);
+    ampl_vec[j] = psi(row[j],icol);
 }
 
 void Wavefunction::get_amplitudes(std::complex<double>& elem, const int& irow, 
   const int& jcol) const
 {
-  elem = psi_(irow,jcol);
+  elem = psi(irow,jcol);
 }
 
 
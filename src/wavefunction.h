@@ -9,10 +9,13 @@
 #define WAVEFUNCTION_H
 
 #include <complex>
+#include <memory>
+#include <list>
 #include <Eigen/Eigenvalues>
 #include "./constants.h"
 #include "./matrix.h"
 #include "./lattice.h"
+#include "./amplitude_table.h"
 
 enum class wf_id {FEARMISEA, BCS};
 
@@ -24,6 +27,14 @@ public:
   	{ init(id, lattice, hole_doping); }
   ~Wavefunction() {}
   void init(const wf_id& id, const Lattice& lattice, const double& hole_doping=0.0);
+  // whether 'compute' is implemented for the wavefunction on the lattice
+  static bool supports(const wf_id& id, const lattice_id& lattice);
+  void set_table_mode(const table_mode& mode, const std::string& dir="");
+  // shared tables left behind by killed runs (see AmplitudeTable)
+  static int remove_unused_tables(const table_mode& mode, const std::string& dir);
+  // tables kept for reuse, 1 (default): the current one only (opt in to 
+  // more for scans that revisit parameters, each costs an N x N table)
+  void set_memo(const int& capacity, const double& tolerance=1.0E-12);
   void compute(const Lattice& lattice, const RealVector& vparams, 
     const int& start_pos, const bool& psi_gradient=false);
   const int& num_upspins(void) const { return num_upspins_; }
@@ -50,13 +61,42 @@ private:
   double band_filling_;
   double ch_potential_;
   RealVector vparams_;
-  ComplexMatrix psi_;
+  // pair amplitudes (possibly shared with other walkers)
+  table_mode table_mode_{table_mode::PRIVATE};
+  std::string table_dir_{"/tmp"};
+  // bump whenever the way tables are built changes (invalidates caches)
+  static const int table_format_version_ = 1;
+  static const char* const table_prefix_;
+  std::shared_ptr<AmplitudeTable> psi_table_;
+  const std::complex<double>* psi_{nullptr};
+  int psi_ld_{0};
+  // built tables for recently used 'vparams' (most recent first), with
+  // the lattice & storage they were built for ('context_key'); one entry 
+  // is the current table, more cost a table each
+  struct memo_entry 
+  {
+    std::uint64_t context;
+    RealVector vparams;
+    std::shared_ptr<AmplitudeTable> table;
+  };
+  std::list<memo_entry> memo_;
+  int memo_capacity_{1};
+  double memo_tolerance_{1.0E-12};
+  // parameter independent parts, computed once per 'init'
+  bool have_dispersion_{false};
+  std::uint64_t dispersion_key_{0}; // of the lattice
+  RealVector ek_; // band dispersion
+  RealVector gk_; // d-wave form factor
   std::vector<RealMatrix> psi_gradient_;
   //bool have_gradient_{false};
   // matrices & solvers
 	void set_particle_num(const double& hole_doping);
+  const std::complex<double>& psi(const int& i, const int& j) const 
+    { return psi_[i+j*psi_ld_]; }
+  KeyHash table_key(const Lattice& lattice, const RealVector& vparams) const;
+  KeyHash context_key(const Lattice& lattice) const;
   void compute_BCS(const Lattice& lattice, const RealVector& vparams, 
-    const int& start_pos, const bool& psi_gradient=false);
+    const int& start_pos, ComplexMatrixMap& psi_mat, const bool& psi_gradient=false);
 };
 
 